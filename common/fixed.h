@@ -0,0 +1,279 @@
+/**
+ * @file
+ * @brief Saturating fixed-point arithmetic shared by the controller and LCD firmware.
+ *
+ * Header only, so each firmware compiles just the functions it calls. Q8.8 values hold a signed 8-bit integer part
+ * and 8 fraction bits in an int16_t, Q16.16 values 16 and 16 in an int32_t. Arithmetic saturates at the limits of the
+ * type instead of wrapping.
+ *
+ * Nothing here divides at run time. Division by a constant is a multiply by its reciprocal, FIXED_RECIP(d), and a
+ * single correction step; decimal digits come from subtracting powers of ten, which needs neither a multiplier (the
+ * FR2310 has none) nor a divide routine. Nothing is wider than 32 bits either: Q16.16 products are built from four
+ * 16 x 16 bit multiplies, which the FR2355's MPY32 does in hardware, instead of pulling in the 64-bit multiply helper.
+ *
+ * Right shifts of negative values are assumed to be arithmetic, as they are with both MSP430 compilers and on the host.
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+typedef int16_t q8_8_t;
+typedef int32_t q16_16_t;
+
+#define Q8_8_ONE 256
+#define Q16_16_ONE 65536L
+
+/** Q8.8 constant from a numeric literal, rounded to nearest. Only for constant expressions. */
+#define Q8_8(x) ((q8_8_t)((x) * 256.0 + (((x) < 0) ? -0.5 : 0.5)))
+
+/** Q16.16 constant from a numeric literal, rounded to nearest. Only for constant expressions. */
+#define Q16_16(x) ((q16_16_t)((x) * 65536.0 + (((x) < 0) ? -0.5 : 0.5)))
+
+/** Reciprocal of a divisor 1 - 65535 for fixed_udiv() and fixed_sdiv(); a compile-time constant for constant d. */
+#define FIXED_RECIP(d) ((uint32_t)(65536UL / (d)))
+
+#define FIXED_DIGITS_MAX 5       // Decimal digits in a uint16_t
+#define FIXED_LONG_DIGITS_MAX 10 // Decimal digits in a uint32_t
+
+static inline int32_t fixed_clamp(int32_t value, int32_t low, int32_t high)
+{
+    return (value < low) ? low : (value > high) ? high : value;
+}
+
+static inline q8_8_t q8_8_sat(int32_t value)
+{
+    return (q8_8_t)fixed_clamp(value, INT16_MIN, INT16_MAX);
+}
+
+static inline q8_8_t q8_8_from_int(int value)
+{
+    return q8_8_sat((int32_t)value * Q8_8_ONE);
+}
+
+/**
+ * @return: Integer part, rounded towards minus infinity.
+ */
+static inline int q8_8_to_int(q8_8_t value)
+{
+    return value >> 8;
+}
+
+static inline q8_8_t q8_8_add(q8_8_t a, q8_8_t b)
+{
+    return q8_8_sat((int32_t)a + b);
+}
+
+static inline q8_8_t q8_8_sub(q8_8_t a, q8_8_t b)
+{
+    return q8_8_sat((int32_t)a - b);
+}
+
+/**
+ * @return: a * b, rounded to nearest.
+ */
+static inline q8_8_t q8_8_mul(q8_8_t a, q8_8_t b)
+{
+    return q8_8_sat(((int32_t)a * b + (Q8_8_ONE / 2)) >> 8);
+}
+
+static inline q16_16_t q16_16_from_int(int32_t value)
+{
+    return (value > INT16_MAX) ? INT32_MAX : (value < INT16_MIN) ? INT32_MIN : (q16_16_t)((uint32_t)value << 16);
+}
+
+/**
+ * @return: Integer part, rounded towards minus infinity.
+ */
+static inline int32_t q16_16_to_int(q16_16_t value)
+{
+    return value >> 16;
+}
+
+static inline q16_16_t q16_16_add(q16_16_t a, q16_16_t b)
+{
+    uint32_t sum = (uint32_t)a + (uint32_t)b;
+
+    if (((uint32_t)a ^ sum) & ((uint32_t)b ^ sum) & 0x80000000UL) // Both operands differ in sign from the sum
+    {
+        return (a < 0) ? INT32_MIN : INT32_MAX;
+    }
+    return (q16_16_t)sum;
+}
+
+static inline q16_16_t q16_16_sub(q16_16_t a, q16_16_t b)
+{
+    uint32_t difference = (uint32_t)a - (uint32_t)b;
+
+    if (((uint32_t)a ^ (uint32_t)b) & ((uint32_t)a ^ difference) & 0x80000000UL)
+    {
+        return (a < 0) ? INT32_MIN : INT32_MAX;
+    }
+    return (q16_16_t)difference;
+}
+
+/**
+ * (a * b + round) >> 16 of two magnitudes, from the four 16 x 16 bit partial products.
+ *
+ * @param: a Magnitude.
+ * @param: b Magnitude.
+ * @param: round Added to the 64-bit product before the shift, 0 - 0xFFFF.
+ * @param: limit Largest result; anything larger saturates to it.
+ */
+static inline uint32_t fixed_umul16(uint32_t a, uint32_t b, uint16_t round, uint32_t limit)
+{
+    uint16_t a_high = a >> 16;
+    uint16_t a_low = a & 0xFFFF;
+    uint16_t b_high = b >> 16;
+    uint16_t b_low = b & 0xFFFF;
+    uint32_t high = (uint32_t)a_high * b_high;
+    uint32_t result;
+    uint32_t term;
+
+    if (high > (limit >> 16))
+    {
+        return limit;
+    }
+    result = high << 16;
+    term = (uint32_t)a_high * b_low;
+    if (term > limit - result)
+    {
+        return limit;
+    }
+    result += term;
+    term = (uint32_t)a_low * b_high;
+    if (term > limit - result)
+    {
+        return limit;
+    }
+    result += term;
+    term = ((uint32_t)a_low * b_low + round) >> 16; // At most 0xFFFE0001 + 0xFFFF, so no carry is lost
+    return (term > limit - result) ? limit : result + term;
+}
+
+/**
+ * @return: a * b, rounded to nearest with halves rounded up, and saturated.
+ */
+static inline q16_16_t q16_16_mul(q16_16_t a, q16_16_t b)
+{
+    uint32_t a_magnitude = (a < 0) ? 0 - (uint32_t)a : (uint32_t)a;
+    uint32_t b_magnitude = (b < 0) ? 0 - (uint32_t)b : (uint32_t)b;
+
+    if ((a < 0) != (b < 0))
+    {
+        // floor((-m + 0x8000) / 2^16) is -floor((m + 0x7FFF) / 2^16)
+        return (q16_16_t)(0 - fixed_umul16(a_magnitude, b_magnitude, 0x7FFF, 0x80000000UL));
+    }
+    return (q16_16_t)fixed_umul16(a_magnitude, b_magnitude, 0x8000, INT32_MAX);
+}
+
+/**
+ * Scale an integer by a Q16.16 factor.
+ *
+ * @return: value * factor, rounded to nearest with halves rounded up, and saturated to int32_t.
+ */
+static inline int32_t q16_16_scale(int32_t value, q16_16_t factor)
+{
+    return q16_16_mul(value, factor);
+}
+
+/**
+ * Unsigned division by multiplying with a reciprocal.
+ *
+ * The product with the truncated reciprocal is at most one below the true quotient, and one compare puts that right,
+ * so the result is exact for every x.
+ *
+ * @param: x Dividend.
+ * @param: d Divisor, 1 - 65535.
+ * @param: recip FIXED_RECIP(d).
+ *
+ * @return: x / d, as C rounds it.
+ */
+static inline uint16_t fixed_udiv(uint16_t x, uint16_t d, uint32_t recip)
+{
+    uint16_t q = (uint16_t)(((uint32_t)x * recip) >> 16);
+
+    if ((uint16_t)(x - q * d) >= d)
+    {
+        q++;
+    }
+    return q;
+}
+
+/**
+ * Signed division by multiplying with a reciprocal.
+ *
+ * @param: x Dividend.
+ * @param: d Divisor, 1 - 32767.
+ * @param: recip FIXED_RECIP(d).
+ *
+ * @return: x / d, truncated towards zero as C does.
+ */
+static inline int16_t fixed_sdiv(int16_t x, uint16_t d, uint32_t recip)
+{
+    return (x < 0) ? -(int16_t)fixed_udiv((uint16_t)-(int32_t)x, d, recip) : (int16_t)fixed_udiv((uint16_t)x, d, recip);
+}
+
+/**
+ * Write a value as decimal digits, right aligned and zero padded.
+ *
+ * Each digit is found by subtracting its power of ten at most nine times, so the cost is bounded by the width and no
+ * multiply or divide is needed. Digits that do not fit the width are dropped from the left.
+ *
+ * @param: out Buffer of at least width characters; no terminator is written.
+ * @param: value Value to write.
+ * @param: width Digits to write, 1 - FIXED_DIGITS_MAX.
+ */
+static inline void fixed_format(char *out, uint16_t value, unsigned char width)
+{
+    static const uint16_t powers[FIXED_DIGITS_MAX] = {10000, 1000, 100, 10, 1};
+    unsigned char i;
+
+    for (i = 0; i < FIXED_DIGITS_MAX; i++)
+    {
+        char digit = '0';
+
+        while (value >= powers[i])
+        {
+            value -= powers[i];
+            digit++;
+        }
+        if (i >= FIXED_DIGITS_MAX - width)
+        {
+            *out++ = digit;
+        }
+    }
+}
+
+/**
+ * Write a 32-bit value as decimal digits, as fixed_format() does. The 32-bit subtractions cost more than the 16-bit
+ * ones on either MSP430, so values known to fit a uint16_t should go through fixed_format().
+ *
+ * @param: out Buffer of at least width characters; no terminator is written.
+ * @param: value Value to write.
+ * @param: width Digits to write, 1 - FIXED_LONG_DIGITS_MAX.
+ */
+static inline void fixed_format_long(char *out, uint32_t value, unsigned char width)
+{
+    static const uint32_t powers[FIXED_LONG_DIGITS_MAX] = {1000000000UL, 100000000UL, 10000000UL, 1000000UL,
+                                                           100000UL, 10000UL, 1000UL, 100UL, 10UL, 1UL};
+    unsigned char i;
+
+    for (i = 0; i < FIXED_LONG_DIGITS_MAX; i++)
+    {
+        char digit = '0';
+
+        while (value >= powers[i])
+        {
+            value -= powers[i];
+            digit++;
+        }
+        if (i >= FIXED_LONG_DIGITS_MAX - width)
+        {
+            *out++ = digit;
+        }
+    }
+}
+
+#endif // FIXED_H
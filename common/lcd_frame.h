@@ -0,0 +1,31 @@
+/**
+ * @file
+ * @brief Layout of the status frame the controller sends to the LCD boards.
+ *
+ * Frames are addressed either to one display's own address or to the I2C general call address, which every display
+ * listens on. The first byte selects a page; a display takes a broadcast frame only if the page is the one it is
+ * configured to show, and always takes a frame sent to its own address.
+ *
+ * Temperatures are sent as an integer byte and a tenths byte, both two's complement and truncated towards zero so they
+ * carry the same sign.
+ */
+
+#ifndef LCD_FRAME_H
+#define LCD_FRAME_H
+
+#define LCD_GENERAL_CALL 0x00  // I2C general call address, reaches every display
+
+#define LCD_FRAME_PAGE 0       // Page (zone) the frame describes
+#define LCD_FRAME_MODE 1       // Index into the LCD's mode names
+#define LCD_FRAME_AMBIENT 2    // Ambient integer, then tenths
+#define LCD_FRAME_PLATE 4      // Plate integer, then tenths
+#define LCD_FRAME_WINDOW 6     // Averaging window, samples
+#define LCD_FRAME_TARGET 7     // Temperature the plate is driven towards, integer then tenths
+#define LCD_FRAME_SLOPE 9      // Plate rate of change, tenths of a degree C per minute, clamped to +/-127
+#define LCD_FRAME_ETA 10       // Seconds until the plate reaches the target, high byte first
+#define LCD_FRAME_ENERGY 12    // Joules used since the mode was selected, high byte first, saturating at 65535
+#define LCD_FRAME_BYTES 14
+
+#define LCD_ETA_UNKNOWN 0xFFFF // Plate is not moving towards the target
+
+#endif // LCD_FRAME_H
@@ -0,0 +1,17 @@
+/**
+ * @file
+ * @brief Controller state shared between the keypad, Peltier and display logic.
+ */
+
+#ifndef APP_STATE_H
+#define APP_STATE_H
+
+/**
+ * Operating states of the controller.
+ *
+ * LOCKED through UNLOCKED cover the pass code entry, OFF through MATCH_SET are the Peltier modes, and SET_TEMP and
+ * SET_WINDOW are transient entry states that return to the previous Peltier mode.
+ */
+enum State {LOCKED, UNLOCKING, UNLOCKED, OFF, HEAT, COOL, MATCH, MATCH_SET, SET_TEMP, SET_WINDOW};
+
+#endif // APP_STATE_H
@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @brief Controller glue between the sensor reads, the keypad, the zones and the displays.
+ */
+
+#include <stddef.h>
+
+#include "control.h"
+#include "ports.h"
+#include "supervisor.h"
+
+#define LM92_ADDRESS 0x48
+
+// Each zone: {plate sensor, ambient sensor}, output port and heat/cool pins. Further zones take the LM92 at 0x49 - 0x4B
+// and free ADC channels and pins. All zones share one Peltier supply and its power budget.
+static const struct zone zone_config[CONTROL_ZONE_COUNT] = {
+    {.sources = {{SOURCE_LM92, LM92_ADDRESS}, {SOURCE_ADC, 1}}, .mode = OFF, .port = &P1OUT, .heat_pin = BIT7,
+     .cool_pin = BIT6},
+};
+
+void control_configure(struct zone *zones, struct energy_budget *budget)
+{
+    unsigned char index;
+
+    energy_init(budget, Q16_16(ENERGY_RATED_W * CONTROL_PERIOD / 32768.0), CONTROL_ZONE_COUNT, CONTROL_AVERAGE_W,
+                CONTROL_PEAK_MA);
+    for (index = 0; index < CONTROL_ZONE_COUNT; index++)
+    {
+        zones[index] = zone_config[index];
+        zones[index].budget = budget;
+    }
+}
+
+void control_init(struct control *control, struct zone *zones, unsigned char zone_count, struct keypad_fsm *keypad,
+                  struct leds *leds, void (*send)(unsigned char index), unsigned int (*clock)(void),
+                  void (*actuated)(unsigned char index))
+{
+    control->zones = zones;
+    control->zone_count = zone_count;
+    control->keypad = keypad;
+    control->leds = leds;
+    control->seconds = 0;
+    control->send = send;
+    control->clock = clock;
+    control->actuated = actuated;
+}
+
+void control_frame(const struct control *control, unsigned char index, char *frame)
+{
+    const struct zone *zone = &control->zones[index];
+
+    zone_frame(zone, index, (index == CONTROL_ZONE_UI) ? control->keypad->mode_code : keypad_mode_code(zone->mode),
+               control->keypad->window_size, frame);
+}
+
+static void actuated(const struct control *control, unsigned char index)
+{
+    if (control->actuated != NULL)
+    {
+        control->actuated(index);
+    }
+}
+
+/**
+ * Control one zone. The keypad zone also follows the keypad state.
+ */
+static void peltier_control(struct control *control, unsigned char index)
+{
+    struct zone *zone = &control->zones[index];
+    struct keypad_fsm *keypad = control->keypad;
+
+    if (index == CONTROL_ZONE_UI)
+    {
+        zone->mode = keypad->state;
+        zone->setpoint_tenths = keypad->setpoint_tenths;
+    }
+
+    zone_control(zone);
+    actuated(control, index);
+
+    if (index == CONTROL_ZONE_UI)
+    {
+        if (zone->mode == MATCH || zone->mode == MATCH_SET)
+        {
+            control->leds->error_tenths = zone->tenths[ZONE_PLATE] - zone_target(zone);
+            leds_select(control->leds, LEDS_DISTANCE);
+        }
+        else if (zone->drive == PELTIER_HEAT)
+        {
+            leds_select(control->leds, LEDS_HEAT);
+        }
+        else if (zone->drive == PELTIER_COOL)
+        {
+            leds_select(control->leds, LEDS_COOL);
+        }
+        else
+        {
+            leds_select(control->leds, LEDS_OFF);
+        }
+    }
+}
+
+void control_pair_done(struct control *control, unsigned char index)
+{
+    struct zone *zone = &control->zones[index];
+
+    if (zone_deliver(zone, control->keypad->window_size))
+    {
+        peltier_control(control, index);
+        zone_actuated(zone, control->clock());
+        if (control->keypad->state != LOCKED)
+        {
+            control->send(index);
+        }
+    }
+}
+
+void control_second(struct control *control)
+{
+    struct keypad_fsm *keypad = control->keypad;
+    struct zone *zone = &control->zones[CONTROL_ZONE_UI];
+
+    if (keypad->state == LOCKED || keypad->state == UNLOCKING)
+    {
+        control->seconds = 0; // No mode runs while locked
+        return;
+    }
+    if (++control->seconds >= PELTIER_TIMEOUT_S)
+    {
+        control->seconds = 0;
+        keypad_select(keypad, OFF);
+        keypad->events = 0;
+        zone->mode = OFF;
+        zone_stop(zone);
+        actuated(control, CONTROL_ZONE_UI);
+        leds_select(control->leds, LEDS_OFF);
+        control->send(CONTROL_ZONE_UI);
+    }
+}
+
+void control_events(struct control *control)
+{
+    struct keypad_fsm *keypad = control->keypad;
+    unsigned char index;
+
+    if (keypad->events & KEYPAD_EVENT_MODE_CHANGED)
+    {
+        control->seconds = 0;
+    }
+    if (keypad->events & KEYPAD_EVENT_WINDOW_SET)
+    {
+        for (index = 0; index < control->zone_count; index++)
+        {
+            zone_reset_filters(&control->zones[index]); // Every zone averages over the keypad's window
+        }
+    }
+    if (keypad->events & KEYPAD_EVENT_LOCKED)
+    {
+        control_stop(control); // No acquisition or control runs while locked, nor the mode timeout
+    }
+    keypad->events = 0;
+    control->send(CONTROL_ZONE_UI);
+}
+
+void control_stop(struct control *control)
+{
+    unsigned char index;
+
+    for (index = 0; index < control->zone_count; index++)
+    {
+        zone_stop(&control->zones[index]);
+        actuated(control, index);
+    }
+    leds_select(control->leds, LEDS_OFF);
+}
+
+void control_recover(struct control *control, unsigned char missed)
+{
+    if (missed & ~(1 << SUPERVISOR_DISPLAY))
+    {
+        control_stop(control);
+    }
+}
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief Controller glue between the sensor reads, the keypad, the zones and the displays.
+ *
+ * What the firmware does with an input once its interrupt has taken it: control a zone when both of its readings are
+ * in, act on keypad and UART events, time out the keypad zone's mode and stop every zone. None of it touches a
+ * peripheral directly; frames go out through a send hook and the time comes from a clock hook. main.c and
+ * sim/trace_replay.c both link this module, so a replayed trace runs exactly the code the board ran.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "energy.h"
+#include "keypad.h"
+#include "leds.h"
+#include "zone.h"
+
+#define CONTROL_ZONE_COUNT 1     // Configured zones, up to ZONE_MAX
+#define CONTROL_ZONE_UI 0        // Zone driven by the keypad and shown on the LCD
+#define CONTROL_PERIOD 16384     // ACLK counts between updates of the same zone, 0.5 s
+#define CONTROL_AVERAGE_W 24     // Average Peltier power for all zones, watts; the P command can change it
+#define CONTROL_PEAK_MA 3000     // Peltier supply current for all zones; one zone drives at a time
+
+/**
+ * Controller state shared by the interrupts.
+ */
+struct control
+{
+    /** Zone table */
+    struct zone *zones;
+
+    /** Entries in zones */
+    unsigned char zone_count;
+
+    /** Keypad state machine, which the keypad zone follows */
+    struct keypad_fsm *keypad;
+
+    /** LED bar, which shows the keypad zone */
+    struct leds *leds;
+
+    /** Seconds in the current mode */
+    volatile unsigned int seconds;
+
+    /** Start sending a zone's frame, built with control_frame(), to the displays */
+    void (*send)(unsigned char index);
+
+    /** Current time, in the clock of zone_sample() */
+    unsigned int (*clock)(void);
+
+    /** Called each time a zone's outputs have been set, or NULL */
+    void (*actuated)(unsigned char index);
+};
+
+/**
+ * Fill in the configured zone table and the power budget they share.
+ *
+ * @param: zones Room for CONTROL_ZONE_COUNT zones.
+ * @param: budget Power budget to initialise.
+ */
+void control_configure(struct zone *zones, struct energy_budget *budget);
+
+/**
+ * Set up the glue around already initialised zones, keypad and LEDs.
+ *
+ * @param: control Context to initialise.
+ * @param: zones Zone table.
+ * @param: zone_count Entries in zones.
+ * @param: keypad Keypad state machine.
+ * @param: leds LED bar.
+ * @param: send Frame send hook.
+ * @param: clock Clock hook.
+ * @param: actuated Output hook, or NULL.
+ */
+void control_init(struct control *control, struct zone *zones, unsigned char zone_count, struct keypad_fsm *keypad,
+                  struct leds *leds, void (*send)(unsigned char index), unsigned int (*clock)(void),
+                  void (*actuated)(unsigned char index));
+
+/**
+ * Build a zone's frame. The keypad zone shows the keypad's mode, including its entry states.
+ *
+ * @param: control Context.
+ * @param: index Zone.
+ * @param: frame LCD_FRAME_BYTES bytes.
+ */
+void control_frame(const struct control *control, unsigned char index, char *frame);
+
+/**
+ * Both readings of a zone's epoch are in: average them as a pair, control on them at once and refresh the zone's
+ * page, once per control period. The clock is read once the outputs are set, for the zone's latency.
+ *
+ * @param: control Context.
+ * @param: index Zone.
+ */
+void control_pair_done(struct control *control, unsigned char index);
+
+/**
+ * Count a second of the heartbeat. Once the keypad zone's mode has run for PELTIER_TIMEOUT_S, switch it to OFF and
+ * stop the zone, whether or not its readings are coming in. The count is held at 0 while locked.
+ *
+ * @param: control Context.
+ */
+void control_second(struct control *control);
+
+/**
+ * Act on the events of the last keypad transition, whether it came from a key press or a UART command, and show the
+ * result. Clears keypad->events.
+ *
+ * @param: control Context.
+ */
+void control_events(struct control *control);
+
+/**
+ * Turn every zone's outputs and the LED bar off.
+ *
+ * @param: control Context.
+ */
+void control_stop(struct control *control);
+
+/**
+ * Act on missed supervisor deadlines: unless only the display link missed, stop every zone. Restarting the
+ * peripherals that missed is left to the caller.
+ *
+ * @param: control Context.
+ * @param: missed Deadlines missed, 1 << enum supervisor_task each.
+ */
+void control_recover(struct control *control, unsigned char missed);
+
+#endif // CONTROL_H
@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Peltier power budget and energy accounting.
+ */
+
+#include "energy.h"
+
+/**
+ * Watt-ticks one update of drive spends from the average power credit.
+ */
+static long update_cost(const struct energy_budget *budget)
+{
+    return (long)ENERGY_RATED_W * budget->zones;
+}
+
+void energy_init(struct energy_budget *budget, q16_16_t update_j, unsigned char zones, unsigned int average_w,
+                 unsigned int peak_ma)
+{
+    budget->update_j = update_j;
+    budget->zones = zones;
+    budget->average_w = average_w;
+    budget->peak_ma = peak_ma;
+    budget->credit = ENERGY_BURST_UPDATES * update_cost(budget);
+    budget->driving = 0;
+}
+
+int energy_set_average(struct energy_budget *budget, int average_w)
+{
+    if (average_w < 0 || average_w > ENERGY_AVERAGE_MAX_W)
+    {
+        return -1;
+    }
+    budget->average_w = average_w;
+    return 0;
+}
+
+enum peltier_drive energy_schedule(struct energy_budget *budget, struct energy_meter *meter, enum State mode,
+                                   enum peltier_drive wanted)
+{
+    long cost = update_cost(budget);
+    enum peltier_drive drive = wanted;
+
+    if (mode >= OFF && mode <= MATCH_SET && mode - OFF != meter->mode)
+    {
+        meter->mode = mode - OFF;
+        meter->mode_updates = 0;
+    }
+
+    // Every call is one control tick of credit; an unlimited budget keeps it full
+    budget->credit += budget->average_w ? (long)budget->average_w : cost;
+    if (budget->credit > ENERGY_BURST_UPDATES * cost)
+    {
+        budget->credit = ENERGY_BURST_UPDATES * cost;
+    }
+    energy_release(budget, meter);
+
+    if (meter->off_updates >= ENERGY_REVERSE_UPDATES)
+    {
+        meter->direction = PELTIER_OFF; // Rested as long as a hold, so neither direction is a reversal
+        meter->hold = 0;
+    }
+    if (meter->off_updates < 0xFF)
+    {
+        meter->off_updates++; // Until it drives below
+    }
+
+    if (drive != PELTIER_OFF && meter->direction != PELTIER_OFF && drive != meter->direction)
+    {
+        meter->direction = drive;
+        meter->hold = ENERGY_REVERSE_UPDATES;
+    }
+
+    if (drive == PELTIER_OFF)
+    {
+        return drive;
+    }
+    if (meter->hold)
+    {
+        meter->hold--;
+        return PELTIER_OFF;
+    }
+    if (budget->credit < cost)
+    {
+        return PELTIER_OFF;
+    }
+    if (budget->peak_ma && (unsigned long)(budget->driving + 1) * ENERGY_RATED_MA > budget->peak_ma)
+    {
+        return PELTIER_OFF;
+    }
+
+    budget->credit -= cost;
+    budget->driving++;
+    meter->on = 1;
+    meter->direction = drive;
+    meter->off_updates = 0;
+    meter->updates[meter->mode]++;
+    if (meter->mode_updates < 0xFFFF)
+    {
+        meter->mode_updates++;
+    }
+    return drive;
+}
+
+void energy_release(struct energy_budget *budget, struct energy_meter *meter)
+{
+    if (meter->on)
+    {
+        meter->on = 0;
+        budget->driving--;
+    }
+}
+
+long energy_joules(const struct energy_budget *budget, unsigned long updates)
+{
+    return q16_16_scale((int32_t)updates, budget->update_j);
+}
@@ -0,0 +1,140 @@
+/**
+ * @file
+ * @brief Peltier power budget and energy accounting.
+ *
+ * The heat and cool outputs are on/off pins, so power is managed as duty over control updates: at each update a zone
+ * either drives at its rated power until its next update or stays off. A budget shared by all zones limits
+ *  - average power: a credit grows by the budgeted watts every control tick and driving a zone for one update spends
+ *    its rated watts for each tick until the zone's next update. The credit is capped at ENERGY_BURST_UPDATES updates
+ *    of drive, so the limit holds over any few seconds and not just on average since reset;
+ *  - peak current: a zone may only start driving while the zones already driving leave room for its rated current.
+ *
+ * A change from heating to cooling or back holds the zone off for ENERGY_REVERSE_UPDATES (2 s at the 0.5 s control
+ * period) before it drives the other way, so the module never steps from full heating to full cooling. A zone that
+ * has been off for that many updates in a row, whatever the reason, has had its rest and may start either way at once.
+ * With one on/off decision per update there is no partial duty to ramp through, so the hold is the whole of the soft
+ * start.
+ *
+ * Energy is estimated from the rated power and the time driven, per Peltier mode and since the current mode was
+ * selected. States outside OFF - MATCH_SET (locked, entering a value) count towards the mode they interrupted.
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "app_state.h"
+#include "fixed.h"
+#include "peltier.h"
+
+#define ENERGY_RATED_W 36          // Electrical power of one Peltier while driven, 12 V at 3 A
+#define ENERGY_RATED_MA 3000       // Current one Peltier draws while driven
+#define ENERGY_AVERAGE_MAX_W 255   // Largest average power budget that may be configured
+#define ENERGY_BURST_UPDATES 4     // Updates of full drive the average power credit can save up
+#define ENERGY_REVERSE_UPDATES 4   // Updates a zone is held off when it changes direction
+#define ENERGY_MODES (MATCH_SET - OFF + 1) // Peltier modes energy is kept for, indexed by mode - OFF
+
+/**
+ * Budget shared by all zones.
+ */
+struct energy_budget
+{
+    /** Joules one zone uses in one update of drive, Q16.16 */
+    q16_16_t update_j;
+
+    /** Average power credit, watt-ticks */
+    long credit;
+
+    /** Average power allowed for all zones together, watts; 0 for no limit */
+    unsigned int average_w;
+
+    /** Current allowed for all zones together, mA; 0 for no limit */
+    unsigned int peak_ma;
+
+    /** Zones updated in turn; each drives for this many control ticks per update */
+    unsigned char zones;
+
+    /** Zones driving now */
+    unsigned char driving;
+};
+
+/**
+ * Scheduling and energy state of one zone. All zero is the state after reset.
+ */
+struct energy_meter
+{
+    /** Updates driven in each Peltier mode, indexed by mode - OFF */
+    unsigned long updates[ENERGY_MODES];
+
+    /** Updates driven since the current mode was selected */
+    unsigned int mode_updates;
+
+    /** Peltier mode being accounted, as mode - OFF */
+    unsigned char mode;
+
+    /** Direction last driven, an enum peltier_drive */
+    unsigned char direction;
+
+    /** Updates still to hold off after a reversal */
+    unsigned char hold;
+
+    /** Updates in a row the zone has not driven, up to 255 */
+    unsigned char off_updates;
+
+    /** Non-zero while counted in the budget's driving zones */
+    unsigned char on;
+};
+
+/**
+ * Set up a budget with its credit full.
+ *
+ * @param: budget Budget to initialise.
+ * @param: update_j Joules one zone uses in one update of drive, Q16.16: rated watts times its control period.
+ * @param: zones Zones updated in turn, 1 - ZONE_MAX.
+ * @param: average_w Average power for all zones, 0 - ENERGY_AVERAGE_MAX_W watts; 0 for no limit.
+ * @param: peak_ma Peak current for all zones, mA; 0 for no limit.
+ */
+void energy_init(struct energy_budget *budget, q16_16_t update_j, unsigned char zones, unsigned int average_w,
+                 unsigned int peak_ma);
+
+/**
+ * Change the average power budget.
+ *
+ * @param: budget Budget.
+ * @param: average_w Watts for all zones, 0 - ENERGY_AVERAGE_MAX_W; 0 for no limit.
+ *
+ * @return: 0 on success, -1 if out of range (the budget is unchanged).
+ */
+int energy_set_average(struct energy_budget *budget, int average_w);
+
+/**
+ * Decide what a zone actually drives at this update and account for it. Call once per control update of the zone.
+ *
+ * @param: budget Budget shared by all zones.
+ * @param: meter Zone's scheduling state.
+ * @param: mode Zone's current state.
+ * @param: wanted Drive the control decision asked for.
+ *
+ * @return: wanted, or PELTIER_OFF if a reversal, the average power or the peak current holds the zone off.
+ */
+enum peltier_drive energy_schedule(struct energy_budget *budget, struct energy_meter *meter, enum State mode,
+                                   enum peltier_drive wanted);
+
+/**
+ * The zone's outputs were turned off outside energy_schedule(); release its share of the peak current.
+ *
+ * @param: budget Budget shared by all zones.
+ * @param: meter Zone's scheduling state.
+ */
+void energy_release(struct energy_budget *budget, struct energy_meter *meter);
+
+/**
+ * Convert driven updates to energy.
+ *
+ * @param: budget Budget the updates were driven under.
+ * @param: updates Updates driven.
+ *
+ * @return: Joules, rounded to nearest.
+ */
+long energy_joules(const struct energy_budget *budget, unsigned long updates);
+
+#endif // ENERGY_H
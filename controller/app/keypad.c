@@ -0,0 +1,267 @@
+/**
+ * @file
+ * @brief Table-driven keypad state machine.
+ */
+
+#include "keypad.h"
+
+// Keypad data
+// 2D Array, each array is a row, each item is a column.
+
+static const char key_pad[4][4] = {{'1', '2', '3', 'A'},  // Top Row
+                                   {'4', '5', '6', 'B'},
+                                   {'7', '8', '9', 'C'},
+                                   {'*', '0', '#', 'D'}}; // Bottom Row
+/*                                   ^              ^
+ *                                   |              |
+ *                                   Left Column    Right Column
+ */
+
+static const char pass_code[] = "2659";
+
+/**
+ * Per key argument for the actions: the digit value for digit keys, the target state for mode keys.
+ */
+static const unsigned char key_value[KEYPAD_KEYS] = {1, 2, 3, HEAT,
+                                                     4, 5, 6, COOL,
+                                                     7, 8, 9, MATCH,
+                                                     0, 0, MATCH_SET, OFF};
+
+/**
+ * Mode index the LCD expects for each state; only the Peltier modes are ever sent.
+ */
+static const unsigned char mode_codes[SET_WINDOW + 1] = {
+    [OFF] = 2, [HEAT] = 0, [COOL] = 1, [MATCH] = 3, [MATCH_SET] = 4,
+};
+
+enum action {NONE, CODE, MODE, ENTER_TEMP, ENTER_WINDOW, DIGIT, POINT, STORE_TEMP, STORE_WINDOW, ACTIONS};
+
+/**
+ * Transition table, one row per state, one column per key code.
+ */
+static const unsigned char transitions[SET_WINDOW + 1][KEYPAD_KEYS] = {
+#define CODE_ROW {CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE, CODE}
+#define MODE_ROW {NONE, NONE, NONE, MODE, NONE, NONE, NONE, MODE, NONE, NONE, NONE, MODE, ENTER_TEMP, ENTER_WINDOW, \
+                  MODE, MODE}
+    [LOCKED] = CODE_ROW,
+    [UNLOCKING] = CODE_ROW,
+    [UNLOCKED] = MODE_ROW,
+    [OFF] = MODE_ROW,
+    [HEAT] = MODE_ROW,
+    [COOL] = MODE_ROW,
+    [MATCH] = MODE_ROW,
+    [MATCH_SET] = MODE_ROW,
+    [SET_TEMP] = {DIGIT, DIGIT, DIGIT, MODE, DIGIT, DIGIT, DIGIT, MODE, DIGIT, DIGIT, DIGIT, MODE, POINT, DIGIT,
+                  STORE_TEMP, MODE},
+    [SET_WINDOW] = {DIGIT, DIGIT, DIGIT, MODE, DIGIT, DIGIT, DIGIT, MODE, DIGIT, DIGIT, DIGIT, MODE, NONE, DIGIT,
+                    STORE_WINDOW, MODE},
+#undef CODE_ROW
+#undef MODE_ROW
+};
+
+static void action_none(struct keypad_fsm *fsm, unsigned char key)
+{
+    (void)fsm;
+    (void)key;
+}
+
+/**
+ * Collect a pass code digit, checking the code once all four are in.
+ */
+static void action_code(struct keypad_fsm *fsm, unsigned char key)
+{
+    int i;
+
+    fsm->state = UNLOCKING;
+    fsm->input_code[fsm->code_index] = keypad_char(key);
+    if (fsm->code_index >= KEYPAD_CODE_LENGTH - 1)
+    {
+        fsm->code_index = 0;
+        fsm->state = UNLOCKED;
+        fsm->events |= KEYPAD_EVENT_CODE_ENTERED;
+        for (i = 0; i < KEYPAD_CODE_LENGTH; i++)
+        {
+            if (fsm->input_code[i] != pass_code[i])
+            {
+                fsm->state = LOCKED;
+                break;
+            }
+        }
+    }
+    else
+    {
+        fsm->code_index++;
+    }
+}
+
+static void action_mode(struct keypad_fsm *fsm, unsigned char key)
+{
+    keypad_select(fsm, (enum State)key_value[key]);
+}
+
+static void action_enter_temp(struct keypad_fsm *fsm, unsigned char key)
+{
+    (void)key;
+    fsm->state = SET_TEMP;
+    fsm->entry = -1; // Empty until the first digit, which keypad_set_setpoint() rejects like an empty window
+    fsm->entry_point = 0;
+}
+
+static void action_enter_window(struct keypad_fsm *fsm, unsigned char key)
+{
+    (void)key;
+    fsm->state = SET_WINDOW;
+    fsm->entry = 0;
+}
+
+/**
+ * Append a digit. Setpoints are built in tenths; digits that would overflow the field are ignored.
+ */
+static void action_digit(struct keypad_fsm *fsm, unsigned char key)
+{
+    int digit = key_value[key];
+
+    if (fsm->entry < 0)
+    {
+        fsm->entry = 0;
+    }
+    if (fsm->state == SET_WINDOW)
+    {
+        if (fsm->entry * 10 + digit <= WINDOW_MAX)
+        {
+            fsm->entry = fsm->entry * 10 + digit;
+        }
+    }
+    else if (fsm->entry_point == 1)
+    {
+        fsm->entry += digit;
+        fsm->entry_point = 2; // Only one tenths digit
+    }
+    else if (fsm->entry_point == 0 && fsm->entry * 10 + digit * 10 <= SETPOINT_MAX_TENTHS)
+    {
+        fsm->entry = fsm->entry * 10 + digit * 10;
+    }
+}
+
+static void action_point(struct keypad_fsm *fsm, unsigned char key)
+{
+    (void)key;
+    if (fsm->entry_point == 0)
+    {
+        fsm->entry_point = 1;
+    }
+}
+
+static void action_store_temp(struct keypad_fsm *fsm, unsigned char key)
+{
+    (void)key;
+    keypad_set_setpoint(fsm, fsm->entry); // An empty entry leaves the setpoint as it was
+    fsm->state = fsm->sub_state;
+}
+
+static void action_store_window(struct keypad_fsm *fsm, unsigned char key)
+{
+    (void)key;
+    keypad_set_window(fsm, fsm->entry); // An empty entry leaves the window as it was
+    fsm->state = fsm->sub_state;
+}
+
+static void (*const actions[ACTIONS])(struct keypad_fsm *fsm, unsigned char key) = {
+    [NONE] = action_none,
+    [CODE] = action_code,
+    [MODE] = action_mode,
+    [ENTER_TEMP] = action_enter_temp,
+    [ENTER_WINDOW] = action_enter_window,
+    [DIGIT] = action_digit,
+    [POINT] = action_point,
+    [STORE_TEMP] = action_store_temp,
+    [STORE_WINDOW] = action_store_window,
+};
+
+void keypad_init(struct keypad_fsm *fsm)
+{
+    fsm->state = LOCKED;
+    fsm->sub_state = UNLOCKED;
+    fsm->mode_code = mode_codes[OFF];
+    fsm->setpoint_tenths = 0;
+    fsm->window_size = 3;
+    fsm->entry = 0;
+    fsm->entry_point = 0;
+    fsm->code_index = 0;
+    fsm->events = 0;
+}
+
+void keypad_lock(struct keypad_fsm *fsm)
+{
+    if (fsm->state != LOCKED && fsm->state != UNLOCKING)
+    {
+        fsm->events |= KEYPAD_EVENT_LOCKED;
+    }
+    fsm->state = LOCKED;
+    fsm->code_index = 0;
+}
+
+void keypad_select(struct keypad_fsm *fsm, enum State mode)
+{
+    fsm->state = mode;
+    if (fsm->state != fsm->sub_state)
+    {
+        fsm->events |= KEYPAD_EVENT_MODE_CHANGED;
+    }
+    fsm->sub_state = fsm->state;
+    fsm->mode_code = mode_codes[fsm->state];
+}
+
+int keypad_set_setpoint(struct keypad_fsm *fsm, int tenths)
+{
+    if (tenths < 0 || tenths > SETPOINT_MAX_TENTHS)
+    {
+        return -1;
+    }
+    fsm->setpoint_tenths = tenths;
+    return 0;
+}
+
+int keypad_set_window(struct keypad_fsm *fsm, int window)
+{
+    if (window < 1 || window > WINDOW_MAX)
+    {
+        return -1;
+    }
+    fsm->window_size = window;
+    fsm->events |= KEYPAD_EVENT_WINDOW_SET;
+    return 0;
+}
+
+unsigned char keypad_mode_code(enum State mode)
+{
+    return mode_codes[mode];
+}
+
+void keypad_dispatch(struct keypad_fsm *fsm, unsigned char key)
+{
+    fsm->events = 0;
+    if (key < KEYPAD_KEYS)
+    {
+        actions[transitions[fsm->state][key]](fsm, key);
+    }
+}
+
+char keypad_char(unsigned char key)
+{
+    return key_pad[key >> 2][key & 0x03];
+}
+
+int keypad_key(char legend)
+{
+    unsigned char key;
+
+    for (key = 0; key < KEYPAD_KEYS; key++)
+    {
+        if (keypad_char(key) == legend)
+        {
+            return key;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file
+ * @brief Table-driven keypad state machine.
+ *
+ * Every key press is looked up in a transition table indexed by the current state and the key code, and the action
+ * found there is run through a function table, so a press costs the same whatever the state or key. New modes are
+ * added as a table row rather than another branch in the scan ISR.
+ *
+ * Key codes are row * 4 + column, with row 0 at the top and column 0 on the left, matching the scan in
+ * ISR_TB0_SwitchColumn.
+ *
+ * Entry modes:
+ *  - '*' starts setpoint entry. Digits build the whole degrees, '*' again starts the tenths digit and '#' stores it,
+ *    e.g. "*", "2", "5", "*", "5", "#" sets 25.5 C. '#' before any digit leaves the setpoint as it was.
+ *  - '0' starts window entry. Digits build the sample count and '#' stores it if it is 1 - WINDOW_MAX.
+ *  - A, B, C and D change mode at any time, abandoning an unfinished entry.
+ */
+
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include "app_state.h"
+
+#define KEYPAD_KEYS 16           // 4x4 matrix
+#define WINDOW_MAX 10            // Size of the sample buffers
+#define SETPOINT_MAX_TENTHS 999  // Largest setpoint the LCD can show, 99.9 C
+#define KEYPAD_CODE_LENGTH 4     // Digits in the pass code
+
+#define KEYPAD_EVENT_MODE_CHANGED 0x01 // A different Peltier mode was selected, restart the mode timer
+#define KEYPAD_EVENT_CODE_ENTERED 0x02 // All pass code digits were entered, stop the lockout timer
+#define KEYPAD_EVENT_WINDOW_SET 0x04   // window_size was stored, empty the averaging windows
+#define KEYPAD_EVENT_LOCKED 0x08       // Locked from an unlocked state, control stops so the outputs must go off
+
+/**
+ * Keypad state machine context.
+ */
+struct keypad_fsm
+{
+    /** Current state */
+    enum State state;
+
+    /** Peltier mode to return to after an entry state */
+    enum State sub_state;
+
+    /** MATCH_SET target, tenths of a degree C */
+    int setpoint_tenths;
+
+    /** Value being entered, tenths of a degree C for setpoints; -1 until the first digit of a setpoint */
+    int entry;
+
+    /** Mode index sent to the LCD */
+    unsigned char mode_code;
+
+    /** Boxcar window, samples */
+    unsigned char window_size;
+
+    /** Non-zero once '*' has been pressed during setpoint entry */
+    unsigned char entry_point;
+
+    /** Which pass code digit is next */
+    unsigned char code_index;
+
+    /** Pass code digits entered so far */
+    char input_code[KEYPAD_CODE_LENGTH];
+
+    /** KEYPAD_EVENT_ flags raised by the last key, cleared by keypad_dispatch() */
+    unsigned char events;
+};
+
+/**
+ * Put the state machine into its power-up state: locked, window of 3.
+ *
+ * @param: fsm Context to initialise.
+ */
+void keypad_init(struct keypad_fsm *fsm);
+
+/**
+ * Abandon pass code entry and lock.
+ *
+ * Raises KEYPAD_EVENT_LOCKED if the state machine was unlocked. Events are not cleared first.
+ *
+ * @param: fsm Context.
+ */
+void keypad_lock(struct keypad_fsm *fsm);
+
+/**
+ * Switch to a Peltier mode, as the mode keys do.
+ *
+ * Raises KEYPAD_EVENT_MODE_CHANGED if the mode differs from the previous one. Events are not cleared first, so callers
+ * outside keypad_dispatch() should clear them.
+ *
+ * @param: fsm Context.
+ * @param: mode One of OFF, HEAT, COOL, MATCH or MATCH_SET.
+ */
+void keypad_select(struct keypad_fsm *fsm, enum State mode);
+
+/**
+ * Store a setpoint, as '#' does at the end of setpoint entry.
+ *
+ * @param: fsm Context.
+ * @param: tenths Setpoint, tenths of a degree C, 0 - SETPOINT_MAX_TENTHS.
+ *
+ * @return: 0 on success, -1 if out of range (the setpoint is unchanged).
+ */
+int keypad_set_setpoint(struct keypad_fsm *fsm, int tenths);
+
+/**
+ * Store a boxcar window, as '#' does at the end of window entry, and raise KEYPAD_EVENT_WINDOW_SET.
+ *
+ * @param: fsm Context.
+ * @param: window Samples, 1 - WINDOW_MAX.
+ *
+ * @return: 0 on success, -1 if out of range (the window is unchanged).
+ */
+int keypad_set_window(struct keypad_fsm *fsm, int window);
+
+/**
+ * Mode index the LCD shows for a Peltier mode.
+ *
+ * @param: mode One of OFF, HEAT, COOL, MATCH or MATCH_SET.
+ *
+ * @return: Index into the LCD's mode names.
+ */
+unsigned char keypad_mode_code(enum State mode);
+
+/**
+ * Run the transition for one key press.
+ *
+ * @param: fsm Context.
+ * @param: key Key code, row * 4 + column.
+ */
+void keypad_dispatch(struct keypad_fsm *fsm, unsigned char key);
+
+/**
+ * Character printed on a key.
+ *
+ * @param: key Key code, row * 4 + column.
+ *
+ * @return: The key's legend, '1' - '9', '0', 'A' - 'D', '*' or '#'.
+ */
+char keypad_char(unsigned char key);
+
+/**
+ * Key code for a legend, the inverse of keypad_char().
+ *
+ * @param: legend '0' - '9', 'A' - 'D', '*' or '#'.
+ *
+ * @return: Key code, or -1 if no key carries that legend.
+ */
+int keypad_key(char legend);
+
+#endif // KEYPAD_H
@@ -0,0 +1,135 @@
+/**
+ * @file
+ * @brief LED bar driver and animation engine.
+ */
+
+#include "leds.h"
+
+/**
+ * Where a run of pattern bits lands on a port.
+ */
+struct leds_port
+{
+    /** Output register */
+    volatile unsigned char *out;
+
+    /** Port pins belonging to the bar */
+    unsigned char mask;
+
+    /** Pattern bit of the port's lowest bar pin */
+    unsigned char shift;
+};
+
+static const struct leds_port port_map[] = {
+    {&P5OUT, LED1 | LED2 | LED3 | LED4 | LED5, 0},
+    {&P6OUT, LED6 | LED7 | LED8, 5},
+};
+
+/** Bar filling from LED1, the heat animation; entry n - 1 lights n LEDs */
+static const unsigned char fill_up[] = {0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF};
+
+/** Bar filling from LED8, the cool animation */
+static const unsigned char fill_down[] = {0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE, 0xFF};
+
+static const unsigned char dark[] = {0x00};
+
+/**
+ * A fixed frame sequence.
+ */
+struct leds_animation
+{
+    /** Patterns, shown in order and repeated */
+    const unsigned char *steps;
+
+    /** Entries in steps */
+    unsigned char length;
+
+    /** Frames each step is shown for */
+    unsigned char hold;
+};
+
+static const struct leds_animation animations[LEDS_MODES] = {
+    [LEDS_OFF] = {dark, sizeof(dark), 1},
+    [LEDS_HEAT] = {fill_up, sizeof(fill_up), LEDS_FRAME_HZ / 4},
+    [LEDS_COOL] = {fill_down, sizeof(fill_down), LEDS_FRAME_HZ / 4},
+    [LEDS_DISTANCE] = {dark, sizeof(dark), 1}, // Computed per frame instead
+};
+
+/**
+ * Distance, tenths of a degree C, at which each further LED of the distance bar lights. Roughly doubling, so the bar
+ * reads both the last half degree and a cold start.
+ */
+static const int distance_steps[] = {2, 5, 10, 20, 40, 80, 160, 320};
+
+void update_leds(int pattern)
+{
+    unsigned char i;
+
+    for (i = 0; i < sizeof(port_map) / sizeof(port_map[0]); i++)
+    {
+        const struct leds_port *map = &port_map[i];
+        *map->out = (*map->out & ~map->mask) | ((pattern >> map->shift) & map->mask);
+    }
+}
+
+void leds_init(struct leds *leds)
+{
+    leds->mode = LEDS_OFF;
+    leds->step = 0;
+    leds->held = 0;
+    leds->error_tenths = 0;
+}
+
+void leds_select(struct leds *leds, enum leds_mode mode)
+{
+    if (mode != leds->mode)
+    {
+        leds->mode = mode;
+        leds->step = 0;
+        leds->held = 0;
+    }
+}
+
+/**
+ * Distance bar: fills from LED1 while the plate is below target (heating towards it), from LED8 while above.
+ */
+static unsigned char distance_pattern(int error_tenths)
+{
+    int distance = (error_tenths < 0) ? -error_tenths : error_tenths;
+    unsigned char count = 0;
+
+    while (count < sizeof(distance_steps) / sizeof(distance_steps[0]) && distance >= distance_steps[count])
+    {
+        count++;
+    }
+    if (count == 0)
+    {
+        return LEDS_ON_TARGET;
+    }
+    return (error_tenths < 0) ? fill_up[count - 1] : fill_down[count - 1];
+}
+
+unsigned char leds_frame(struct leds *leds)
+{
+    const struct leds_animation *animation = &animations[leds->mode];
+    unsigned char pattern;
+
+    if (leds->mode == LEDS_DISTANCE)
+    {
+        pattern = distance_pattern(leds->error_tenths);
+    }
+    else
+    {
+        pattern = animation->steps[leds->step];
+        if (++leds->held >= animation->hold)
+        {
+            leds->held = 0;
+            if (++leds->step >= animation->length)
+            {
+                leds->step = 0;
+            }
+        }
+    }
+    update_leds(pattern);
+    return pattern;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @brief LED bar driver and animation engine.
+ *
+ * The eight bar LEDs are spread over P5.0 - P5.4 (LED1 - LED5) and P6.0 - P6.2 (LED6 - LED8). A port map turns a
+ * pattern byte into one masked write per port, so P5 and P6 are each written once per frame and the other pins on
+ * those ports (the P6.6 heartbeat LED) are left alone.
+ *
+ * Animations are constant frame tables, which the linker places in FRAM with the rest of the constants. The engine is
+ * stepped by its own frame timer at LEDS_FRAME_HZ, independent of the 1 Hz heartbeat; each animation says how many
+ * frames each of its steps is held for. The distance bar is not a fixed sequence: it is looked up each frame from the
+ * plate's distance to its target.
+ */
+
+#ifndef LEDS_H
+#define LEDS_H
+
+#include "ports.h"
+
+#define LED1 BIT0
+#define LED2 BIT1
+#define LED3 BIT2
+#define LED4 BIT3
+#define LED5 BIT4
+#define LED6 BIT0
+#define LED7 BIT1
+#define LED8 BIT2
+
+#define LEDS_FRAME_HZ 8        // Engine frame rate
+#define LEDS_ON_TARGET 0x18    // Distance bar when the plate is on target: the middle two LEDs
+
+/**
+ * What the LED bar shows.
+ */
+enum leds_mode {LEDS_OFF, LEDS_HEAT, LEDS_COOL, LEDS_DISTANCE, LEDS_MODES};
+
+/**
+ * Animation engine state.
+ */
+struct leds
+{
+    /** Animation being shown */
+    enum leds_mode mode;
+
+    /** Step of the animation */
+    unsigned char step;
+
+    /** Frames the current step has been shown for */
+    unsigned char held;
+
+    /** Plate minus target, tenths of a degree C, for LEDS_DISTANCE */
+    int error_tenths;
+};
+
+/**
+ * Show a pattern on the LED bar.
+ *
+ * @param: pattern Bit n lights LED n + 1.
+ */
+void update_leds(int pattern);
+
+/**
+ * Start with the bar dark.
+ *
+ * @param: leds Engine to initialise.
+ */
+void leds_init(struct leds *leds);
+
+/**
+ * Choose the animation. Selecting a different one restarts it from its first step.
+ *
+ * @param: leds Engine.
+ * @param: mode Animation to show.
+ */
+void leds_select(struct leds *leds, enum leds_mode mode);
+
+/**
+ * Produce and show the next frame.
+ *
+ * @param: leds Engine.
+ *
+ * @return: The pattern shown.
+ */
+unsigned char leds_frame(struct leds *leds);
+
+#endif // LEDS_H
@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief LM19 analog temperature sensor conversion.
+ */
+
+#include <stdint.h>
+#include "lm19.h"
+
+#define LM19_SEGMENT_SHIFT 7 // 128 ADC counts between table entries
+
+/**
+ * Datasheet curve, -1481.96 + sqrt(2.1962e6 + (1.8639 - V) / 3.88e-6) with V = counts / 4095, in sixteenths of a
+ * tenth of a degree C at every 128 counts from 0 to 4096.
+ */
+static const int16_t curve[(LM19_ADC_MAX >> LM19_SEGMENT_SHIFT) + 2] = {
+    24651, 24257, 23862, 23466, 23070, 22674, 22276, 21879, 21480, 21081, 20681,
+    20281, 19880, 19479, 19076, 18674, 18270, 17866, 17461, 17056, 16650, 16243,
+    15836, 15428, 15019, 14610, 14200, 13789, 13378, 12966, 12553, 12140, 11726,
+};
+
+int lm19_tenths(unsigned int average_adc_value)
+{
+    unsigned int segment = average_adc_value >> LM19_SEGMENT_SHIFT;
+    int32_t offset = average_adc_value & ((1 << LM19_SEGMENT_SHIFT) - 1);
+    int32_t step = curve[segment + 1] - curve[segment];
+    int32_t sixteenths = curve[segment] + ((step * offset) >> LM19_SEGMENT_SHIFT);
+
+    return (int)((sixteenths + 8) >> 4);
+}
@@ -0,0 +1,24 @@
+/**
+ * @file
+ * @brief LM19 analog temperature sensor conversion.
+ */
+
+#ifndef LM19_H
+#define LM19_H
+
+#define LM19_ADC_MAX 4095 // 12-bit conversion
+
+/**
+ * Convert an averaged 12-bit ADC reading of the LM19 output to tenths of a degree C.
+ *
+ * Follows the quadratic transfer function from the LM19 datasheet with a 1 V full-scale reference, interpolated
+ * linearly from a table so no float, square root or divide is needed. The interpolation stays within 0.01 C of the
+ * datasheet curve.
+ *
+ * @param: average_adc_value Averaged ADCMEM0 value, 0 - LM19_ADC_MAX.
+ *
+ * @return: Temperature, tenths of a degree C, rounded to nearest.
+ */
+int lm19_tenths(unsigned int average_adc_value);
+
+#endif // LM19_H
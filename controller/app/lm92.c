@@ -0,0 +1,26 @@
+/**
+ * @file
+ * @brief LM92 digital temperature sensor conversion.
+ */
+
+#include <stdint.h>
+#include "lm92.h"
+
+int lm92_sixteenths(const unsigned char data[2])
+{
+    int16_t word = (int16_t)(((uint16_t)data[0] << 8) | data[1]);
+
+    // The status bits are cleared first so the division is exact and keeps the sign
+    return (int16_t)(word & ~LM92_STATUS_MASK) / 8;
+}
+
+unsigned char lm92_status(const unsigned char data[2])
+{
+    return data[1] & LM92_STATUS_MASK;
+}
+
+int lm92_sixteenths_to_tenths(int sixteenths)
+{
+    // 10/16 reduced to 5/8; |sixteenths| is at most 2400 (150 C) so the product fits in 16 bits
+    return (sixteenths * 5) / 8;
+}
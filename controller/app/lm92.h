@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief LM92 digital temperature sensor conversion.
+ *
+ * The LM92 temperature register holds a 13-bit two's complement temperature in 1/16 degree C steps in D15 - D3, and
+ * the T_LOW, T_HIGH and T_CRIT comparator flags in D2 - D0. Everything here is integer math so no float support is
+ * needed on the MSP430.
+ */
+
+#ifndef LM92_H
+#define LM92_H
+
+#define LM92_STATUS_T_LOW 0x04  // Temperature is below T_LOW
+#define LM92_STATUS_T_HIGH 0x02 // Temperature is above T_HIGH
+#define LM92_STATUS_T_CRIT 0x01 // Temperature is above T_CRIT
+#define LM92_STATUS_MASK (LM92_STATUS_T_LOW | LM92_STATUS_T_HIGH | LM92_STATUS_T_CRIT)
+
+/**
+ * Convert the two bytes read from the LM92 temperature register.
+ *
+ * @param: data Temperature register, most significant byte first.
+ *
+ * @return: Signed temperature in 1/16 degree C.
+ */
+int lm92_sixteenths(const unsigned char data[2]);
+
+/**
+ * Extract the comparator flags from the temperature register.
+ *
+ * @param: data Temperature register, most significant byte first.
+ *
+ * @return: Combination of the LM92_STATUS_ flags.
+ */
+unsigned char lm92_status(const unsigned char data[2]);
+
+/**
+ * Convert 1/16 degree C to tenths of a degree C, truncating towards zero.
+ *
+ * @param: sixteenths Temperature in 1/16 degree C.
+ *
+ * @return: Temperature in tenths of a degree C.
+ */
+int lm92_sixteenths_to_tenths(int sixteenths);
+
+#endif // LM92_H
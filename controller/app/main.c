@@ -1,66 +1,139 @@
 #include <msp430.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <math.h>
+#include "app_state.h"
+#include "control.h"
+#include "energy.h"
+#include "keypad.h"
+#include "lcd_frame.h"
+#include "leds.h"
+#include "lm92.h"
+#include "peltier.h"
+#include "supervisor.h"
+#include "trace.h"
+#include "uart_cmd.h"
+#include "zone.h"
 
 /**
  * main.c
  */
 
-#define LM92_ADDRESS 0x48
-#define LCD_ADDRESS 0x01   // Address of the LCD MSP430FR2310
-#define TX_BYTES 6         // Number of bytes to transmit
-#define LED1 BIT0
-#define LED2 BIT1
-#define LED3 BIT2
-#define LED4 BIT3
-#define LED5 BIT4
-#define LED6 BIT0
-#define LED7 BIT1
-#define LED8 BIT2
-
-// Temperature Data
-volatile int window_size = 3;
-int adc_results[10];
-int lm92_results[10];
-int lm19_sample_index = 0;
-int lm19_samples_collected = 0;
-volatile int lm19_temperature_integer = 0;
-volatile int lm19_temperature_decimal = 0;
-int lm92_samples[10];
-int lm92_sample_index = 0;
-int lm92_samples_collected = 0;
-volatile int lm92_temperature_integer = 0;
-volatile int lm92_temperature_decimal = 0;
-volatile int timer = 0;
-volatile int temp_match = 0;
-int heat = 0;
-int cool = 1;
+#define LCD_ADDRESS LCD_GENERAL_CALL // Broadcast to every LCD MSP430FR2310; use a display's own address to reach one
+#define TX_BYTES LCD_FRAME_BYTES     // Number of bytes to transmit
+#define HEARTBEAT_PERIOD 32768 // ACLK counts between heartbeats, 1 s
+#define LED_FRAME_PERIOD (32768 / LEDS_FRAME_HZ) // ACLK counts between LED frames
+#define SUPERVISOR_PERIOD 4096 // ACLK counts between supervisor ticks, 125 ms
+#define WATCHDOG_FEED (WDTPW | WDTSSEL__ACLK | WDTIS__32K | WDTCNTCL) // Restart the 1 s hardware watchdog
+#define FAULT_WATCHDOG SUPERVISOR_TASKS // fault_counts entry for watchdog resets
+
+// Zone Data
+// The zone table is configured in control.c; all zones share one Peltier supply and its power budget.
+struct energy_budget budget;
+struct zone zones[CONTROL_ZONE_COUNT];
+
+/**
+ * Sensor reads in flight on one peripheral. Each peripheral reads one sensor at a time; the roles still to read this
+ * tick are kept as a bit mask. The reads carry the epoch they were started in, so a reading that arrives late is never
+ * paired with a newer one.
+ */
+struct acquisition
+{
+    /** Epoch the reads were started in */
+    unsigned int epoch;
+
+    /** Zone being read */
+    unsigned char zone;
+
+    /** Role of the sensor being read */
+    unsigned char role;
+
+    /** Bit (1 << role) set for each sensor still to read */
+    unsigned char roles;
+};
+
+/**
+ * LM92 temperature register being received on UCB1.
+ */
+struct lm92_transfer
+{
+    /** Register, high byte first */
+    unsigned char data[2];
+
+    /** Bytes received so far */
+    unsigned char count;
+};
+
+// Acquisition Data
+struct acquisition adc, lm92;
+struct lm92_transfer lm92_rx;
+
+/**
+ * Frame going out to the displays.
+ */
+struct display_link
+{
+    /** Frame bytes */
+    char frame[TX_BYTES];
+
+    /** Next byte to send */
+    volatile unsigned char index;
+};
 
 // I2C Data
-volatile int tx_index = 0;
-char tx_buffer[TX_BYTES] = {0, 0, 0, 0, 0, 3};
-unsigned char lm92_data[2];
-unsigned int lm92_byte_count = 0;
+struct display_link display;
 
 // LED Data
-volatile int step_pattern_heat;
-volatile int step_pattern_cool;
-volatile int pattern = 0;
+struct leds leds;
 
 // State Data
-enum State {LOCKED, UNLOCKING, UNLOCKED, OFF, HEAT, COOL, MATCH, MATCH_SET, SET_TEMP, SET_WINDOW};
-enum State state = LOCKED;
-enum State sub_state = LOCKED;
+struct keypad_fsm keypad;
+
+// UART Data
+struct uart_cmd uart;
+
+// Control Data
+struct control control;
+
+// Supervisor Data
+// Deadlines in ticks of SUPERVISOR_PERIOD. A zone's sensor reads and a display frame take a few ms; the control tick
+// comes every CONTROL_PERIOD / CONTROL_ZONE_COUNT and the keypad scan every 1 ms.
+const struct supervisor_deadline deadlines[SUPERVISOR_TASKS] = {
+    [SUPERVISOR_ACQUISITION] = {2, 0},
+    [SUPERVISOR_CONTROL] = {CONTROL_PERIOD / CONTROL_ZONE_COUNT / SUPERVISOR_PERIOD + 2, 1},
+    [SUPERVISOR_DISPLAY] = {2, 0},
+    [SUPERVISOR_KEYPAD] = {2, 1},
+};
+struct supervisor supervisor;
+
+// Missed deadlines per subsystem, then watchdog resets. Kept in FRAM so they survive the reset they lead to.
+#pragma PERSISTENT(fault_counts)
+unsigned int fault_counts[SUPERVISOR_TASKS + 1] = {0};
+
+// Trace Data
+// Debug builds with TRACE defined record every input for sim/trace_replay.c; other builds compile the hooks out.
+#ifdef TRACE
+#pragma PERSISTENT(trace_log)
+struct trace_log trace_log = {0};
+#define TRACE_RECORD(type, arg, value) trace_record(&trace_log, TB1R, (type), (arg), (value))
+#else
+#define TRACE_RECORD(type, arg, value)
+#endif
 
-void send_I2C_data()
+/**
+ * Pop the next role from a pending mask, plate first.
+ */
+unsigned char next_role(unsigned char *roles)
 {
-    tx_index = 0; // Reset buffer index
-    UCB0CTLW0 |= UCTR | UCTXSTT;  // Start condition, put master in transmit mode
-    UCB0IE |= UCTXIE0; // Enable TX interrupt
+    unsigned char role = (*roles & (1 << ZONE_PLATE)) ? ZONE_PLATE : ZONE_AMBIENT;
+    *roles &= ~(1 << role);
+    return role;
 }
 
 void get_lm92_i2c()
 {
+    lm92.role = next_role(&lm92.roles);
+    lm92_rx.count = 0;
+    UCB1I2CSA = zones[lm92.zone].sources[lm92.role].id;
     UCB1CTLW0 &= ~UCTR;          // Receiver mode
     UCB1CTLW0 |= UCTXSTT;        // Start condition
     UCB1IE |= UCRXIE1;           // Enable RX interrupt
@@ -68,132 +141,259 @@ void get_lm92_i2c()
 
 void start_ADC_conversion()
 {
+    adc.role = next_role(&adc.roles);
+    ADCCTL0 &= ~ADCENC;          // Channel can only change while disabled
+    ADCMCTL0 = (ADCMCTL0 & ~ADCINCH) | zones[adc.zone].sources[adc.role].id;
     ADCCTL0 |= ADCENC | ADCSC;
 }
 
-void update_leds(int pattern)
-   {
-       P5OUT &= ~(LED1 | LED2 | LED3 | LED4 | LED5);
-       P6OUT &= ~(LED6 | LED7 | LED8);
-
-       // Set LEDs based on the pattern
-       P5OUT |= (pattern & 0x01) ? LED1 : 0;
-       P5OUT |= (pattern & 0x02) ? LED2 : 0;
-       P5OUT |= (pattern & 0x04) ? LED3 : 0;
-       P5OUT |= (pattern & 0x08) ? LED4 : 0;
-       P5OUT |= (pattern & 0x10) ? LED5 : 0;
-       P6OUT |= (pattern & 0x20) ? LED6 : 0;
-       P6OUT |= (pattern & 0x40) ? LED7 : 0;
-       P6OUT |= (pattern & 0x80) ? LED8 : 0;
-   }
-
-void get_temperature()
+/**
+ * Start reading every sensor of a zone; the ADC and LM92 reads run side by side.
+ */
+void acquire_zone(unsigned char index)
 {
-    int i;
-    unsigned int total_adc_value = 0;
-    for (i = 1; i <= window_size; i++)
+    int role;
+
+    adc.roles = 0;
+    lm92.roles = 0;
+    for (role = ZONE_PLATE; role <= ZONE_AMBIENT; role++)
     {
-        total_adc_value += adc_results[i];
+        if (zones[index].sources[role].type == SOURCE_LM92)
+        {
+            lm92.roles |= 1 << role;
+        }
+        else
+        {
+            adc.roles |= 1 << role;
+        }
     }
 
-    unsigned int average_adc_value = total_adc_value / window_size;
-    float voltage = (average_adc_value / 4095.0);
-    float temperature = -1481.96 + sqrt(2.1962e6 + ((1.8639 - voltage) / (3.88e-6)));
-    lm19_temperature_integer = (int)temperature;
-    temperature *= 10.0;
-    lm19_temperature_decimal = (int)(temperature - lm19_temperature_integer);
-    tx_buffer[1] = lm19_temperature_integer;
-    tx_buffer[2] = lm19_temperature_decimal;
-
-    if (state != LOCKED)
+    adc.zone = index;
+    lm92.zone = index;
+    adc.epoch = zone_begin(&zones[index], TB1R);
+    lm92.epoch = adc.epoch;
+    supervisor_start(&supervisor, SUPERVISOR_ACQUISITION);
+    if (adc.roles)
     {
-        send_I2C_data();
+        start_ADC_conversion();
     }
+    if (lm92.roles)
+    {
+        get_lm92_i2c();
+    }
+}
+
+/**
+ * Build a zone's frame and send it. One broadcast reaches every display showing that zone's page.
+ */
+void send_I2C_data(unsigned char index)
+{
+    control_frame(&control, index, display.frame);
+
+    display.index = 0; // Reset buffer index
+    supervisor_start(&supervisor, SUPERVISOR_DISPLAY);
+    UCB0CTLW0 |= UCTR | UCTXSTT;  // Start condition, put master in transmit mode
+    UCB0IE |= UCTXIE0 | UCNACKIE; // Enable TX interrupt, and NACK in case no display is listening
 }
 
-void peltier_control()
+/**
+ * TB1 count, the clock of the sensor readings' time stamps.
+ */
+unsigned int read_clock(void)
+{
+    return TB1R;
+}
+
+/**
+ * Both readings of a zone's epoch are in.
+ */
+void pair_done(unsigned char index)
 {
-    if (timer == 300)
+    supervisor_done(&supervisor, SUPERVISOR_ACQUISITION);
+    control_pair_done(&control, index);
+}
+
+/**
+ * Keypad matrix scan.
+ */
+struct keypad_scan
+{
+    /** Milliseconds since the first pass code digit */
+    unsigned int lockout_ms;
+
+    /** Column being driven, 0 on the left */
+    unsigned char column;
+
+    /** Row of the key found pressed, 0 at the top */
+    unsigned char row;
+
+    /** Non-zero from a key press until every key is released */
+    unsigned char key_held;
+};
+
+// Keypad scan data
+struct keypad_scan scan;
+
+/**
+ * Act on the events of the last keypad transition, whether it came from a key press or a UART command.
+ */
+void keypad_events(void)
+{
+    if (keypad.events & KEYPAD_EVENT_CODE_ENTERED)
     {
-        heat = 0;
-        cool = 0;
-        P1OUT &= ~(BIT7 | BIT6);
-        timer = 0;
-        state = OFF;
-        tx_buffer[0] = 2;
+        scan.lockout_ms = 0; // Stop lockout counter
     }
-    if (state == HEAT)
+    control_events(&control);
+}
+
+/**
+ * Count a fault in FRAM. The counts are in program FRAM, which is write protected outside this function.
+ */
+void fault_count(unsigned char kind)
+{
+    unsigned char protect = SYSCFG0 & (PFWP | DFWP);
+
+    SYSCFG0 = FRWPPW | (protect & ~PFWP);
+    if (fault_counts[kind] < 0xFFFF)
     {
-        heat = 1;
-        cool = 0;
-        P1OUT &= ~BIT6;
-        P1OUT |= BIT7;
+        fault_counts[kind]++;
     }
-    else if (state == COOL)
+    SYSCFG0 = FRWPPW | protect;
+}
+
+/**
+ * Free a bus that a slave is holding after an interrupted transfer. With SCL taken from the eUSCI, clock it nine times
+ * so the slave can finish its byte and release SDA. The eUSCI must be in reset.
+ */
+void i2c_bus_clear(volatile unsigned char *sel, volatile unsigned char *dir, volatile unsigned char *out,
+                   unsigned char scl)
+{
+    int pulse;
+
+    *sel &= ~scl;
+    *out &= ~scl;
+    for (pulse = 0; pulse < 9; pulse++)
     {
-        cool = 1;
-        heat = 0;
-        P1OUT &= ~BIT7;
-        P1OUT |= BIT6;
+        *dir |= scl;          // Pull SCL low
+        __delay_cycles(5);
+        *dir &= ~scl;         // Release it to the pull-up
+        __delay_cycles(5);
     }
-    else if (state == MATCH)
+}
+
+/**
+ * Set up UCB0 as the I2C master to the displays, freeing the bus first.
+ */
+void configure_display_i2c(void)
+{
+    // Put eUSCI_B0 into reset mode
+    UCB0CTLW0 = UCSWRST;
+    i2c_bus_clear(&P1SEL0, &P1DIR, &P1OUT, BIT3);
+
+    // Configure P1.2 (SDA) and P1.3 (SCL) for I2C
+    P1SEL0 |= BIT2 | BIT3;
+    P1SEL1 &= ~(BIT2 | BIT3);
+
+    // Set as I2C master, synchronous mode, SMCLK source
+    UCB0CTLW0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;
+
+    // Manually adjusting baud rate to 100 kHz  (1MHz / 10 = 100 kHz)
+    UCB0BRW = 10;
+
+    // Set slave address
+    UCB0I2CSA = LCD_ADDRESS;
+
+    // Release reset state
+    UCB0CTLW0 &= ~UCSWRST;
+
+    // Enable transmit interrupt
+    UCB0IE |= UCTXIE0;
+    display.index = 0;
+}
+
+/**
+ * Set up UCB1 as the I2C master to the LM92s, freeing the bus first.
+ */
+void configure_sensor_i2c(void)
+{
+    // Put eUSCI_B1 into reset mode
+    UCB1CTLW0 = UCSWRST;
+    i2c_bus_clear(&P4SEL0, &P4DIR, &P4OUT, BIT7);
+
+    // Configure P4.6 (SDA) and P4.7 (SCL) for I2C
+    P4SEL0 |= BIT6 | BIT7;
+    P4SEL1 &= ~(BIT6 | BIT7);
+
+    // Set as I2C master, synchronous mode, SMCLK source
+    UCB1CTLW0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;
+
+    // Manually adjusting baud rate to 100 kHz  (1MHz / 10 = 100 kHz)
+    UCB1BRW = 10;
+
+    // Slave address is set per read from the zone table
+
+    // Release reset state
+    UCB1CTLW0 &= ~UCSWRST;
+
+    // Enable receive interrupt
+    UCB1IE |= UCRXIE1;
+}
+
+/**
+ * Act on missed deadlines. Unless only the display link missed, the Peltiers go off first; then the subsystems that
+ * missed are restarted where that can help. Control and keypad scan are timer interrupts with nothing to restart, so
+ * they are left to the hardware watchdog if they keep missing.
+ */
+void recover(unsigned char missed)
+{
+    unsigned char task;
+
+    control_recover(&control, missed);
+    for (task = 0; task < SUPERVISOR_TASKS; task++)
     {
-        if (lm92_temperature_integer > lm19_temperature_integer)
-        {
-            cool = 1;
-            heat = 0;
-            P1OUT &= ~BIT7;
-            P1OUT |= BIT6;
-        }
-        else if (lm92_temperature_integer < lm19_temperature_integer)
+        if (missed & (1 << task))
         {
-            heat = 1;
-            cool = 0;
-            P1OUT &= ~BIT6;
-            P1OUT |= BIT7;
+            fault_count(task);
         }
     }
-    else if (state == MATCH_SET)
+    if (missed & (1 << SUPERVISOR_ACQUISITION))
     {
-        if (lm92_temperature_integer > temp_match)
-        {
-            cool = 1;
-            heat = 0;
-            P1OUT &= ~BIT7;
-            P1OUT |= BIT6;
-        }
-        else if (lm92_temperature_integer < temp_match)
-        {
-            heat = 1;
-            cool = 0;
-            P1OUT &= ~BIT6;
-            P1OUT |= BIT7;
-        }
+        // Abandon the reads and restart the sensors; the next control tick reads the zone again
+        ADCCTL0 &= ~ADCENC;
+        adc.roles = 0;
+        lm92.roles = 0;
+        configure_sensor_i2c();
+    }
+    if (missed & (1 << SUPERVISOR_DISPLAY))
+    {
+        configure_display_i2c();
     }
 }
 
-// Keypad data
-// 2D Array, each array is a row, each item is a column.
-
-char keyPad[][4] = {{'1', '2', '3', 'A'},  // Top Row
-                    {'4', '5', '6', 'B'},
-                    {'7', '8', '9', 'C'},
-                    {'*', '0', '#', 'D'}}; // Bottom Row
-/*                    ^              ^
- *                    |              |
- *                    Left Column    Right Column
- */
-
-int column, row = 0;
-char key_pressed = '\0';
-char pass_code[] = "2659";
-char input_code[] = "0000";
-int mili_seconds_surpassed = 0;
-int index = 0;  // Which index of the above input_code array we're in
-
 int main(void)
 {
+    unsigned int reset_cause;
+
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
+#ifdef TRACE
+    SYSCFG0 = FRWPPW | DFWP;    // The trace log is in program FRAM; leave it writable
+    trace_start(&trace_log);
+#endif
+
+    while ((reset_cause = SYSRSTIV) != SYSRSTIV_NONE)
+    {
+        if (reset_cause == SYSRSTIV_WDTTO)
+        {
+            fault_count(FAULT_WATCHDOG);
+        }
+    }
+
+    keypad_init(&keypad);
+    leds_init(&leds);
+    supervisor_init(&supervisor, deadlines);
+    control_configure(zones, &budget);
+    control_init(&control, zones, CONTROL_ZONE_COUNT, &keypad, &leds, send_I2C_data, read_clock, NULL);
+    uart_cmd_init(&uart, &keypad, zones, CONTROL_ZONE_COUNT);
 
     //---------------- Configure ADC ---------------
     // Set P1.1 as ADC input
@@ -248,74 +448,60 @@ int main(void)
     P1OUT &= ~BIT6;
     //---------------- End Configure Heat/Cool ----------
     //---------------- Configure Timers -----------------
-    //LED Timer
+    //Heartbeat and LED Timer
+    // Free running, so CCR0 (heartbeat), CCR1 (LED frames) and CCR2 (supervisor) each schedule their own next match
     TB1CTL |= TBCLR;
     TB1CTL |= TBSSEL__ACLK;
-    TB1CTL |= MC__UP;
-    TB1CCR0 = 32768;
+    TB1CTL |= MC__CONTINUOUS;
+    TB1CCR0 = HEARTBEAT_PERIOD;
     TB1CCTL0 |= CCIE;
     TB1CCTL0 &= ~CCIFG;
+    TB1CCR1 = LED_FRAME_PERIOD;
+    TB1CCTL1 |= CCIE;
+    TB1CCTL1 &= ~CCIFG;
+    TB1CCR2 = SUPERVISOR_PERIOD;
+    TB1CCTL2 |= CCIE;
+    TB1CCTL2 &= ~CCIFG;
 
     //Temperature Sample Timer
     TB2CTL |= TBCLR;
     TB2CTL |= TBSSEL__ACLK;
     TB2CTL |= MC__UP;
-    TB2CCR0 = 16384;
+    TB2CCR0 = CONTROL_PERIOD / CONTROL_ZONE_COUNT; // Zones are staggered across the control period
     TB2CCTL0 |= CCIE;         //enable TB2 CCR0 Overflow IRQ
     TB2CCTL0 &= ~CCIFG;       //clear CCR0 flag
     //---------------- End Timer Configure --------------
 
-    //---------------- Configure UCB0 I2C ---------------
+    //---------------- Configure UCB0 and UCB1 I2C -------
+    configure_display_i2c();
+    configure_sensor_i2c();
+    //---------------- End Configure I2C ----------------
 
-    // Configure P1.2 (SDA) and P1.3 (SCL) for I2C
-    P1SEL0 |= BIT2 | BIT3;
-    P1SEL1 &= ~(BIT2 | BIT3);
+    //---------------- Configure UCA1 UART --------------
 
-    // Put eUSCI_B0 into reset mode
-    UCB0CTLW0 = UCSWRST;
+    // Configure P4.3 (TXD) and P4.2 (RXD), the LaunchPad's back-channel UART
+    P4SEL0 |= BIT2 | BIT3;
+    P4SEL1 &= ~(BIT2 | BIT3);
 
-    // Set as I2C master, synchronous mode, SMCLK source
-    UCB0CTLW0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;
+    // Put eUSCI_A1 into reset mode
+    UCA1CTLW0 = UCSWRST;
 
-    // Manually adjusting baud rate to 100 kHz  (1MHz / 10 = 100 kHz)
-    UCB0BRW = 10;
+    // 8N1, SMCLK source
+    UCA1CTLW0 |= UCSSEL__SMCLK;
 
-    // Set slave address
-    UCB0I2CSA = LCD_ADDRESS;
+    // 9600 baud from 1 MHz: 1000000 / 9600 / 16 = 6.51, oversampling, UCBRF = 8, UCBRS = 0x20
+    UCA1BRW = 6;
+    UCA1MCTLW = 0x2000 | UCBRF_8 | UCOS16;
 
     // Release reset state
-    UCB0CTLW0 &= ~UCSWRST;
+    UCA1CTLW0 &= ~UCSWRST;
 
-    // Enable transmit interrupt
-    UCB0IE |= UCTXIE0;
-    //---------------- End Configure UCB0 I2C -----------
-
-    //---------------- Configure UCB1 I2C ---------------
-
-    // Configure P4.6 (SDA) and P4.7 (SCL) for I2C
-    P4SEL0 |= BIT6 | BIT7;
-    P4SEL1 &= ~(BIT6 | BIT7);
-
-    // Put eUSCI_B0 into reset mode
-    UCB1CTLW0 = UCSWRST;
-
-    // Set as I2C master, synchronous mode, SMCLK source
-    UCB1CTLW0 |= UCMODE_3 | UCMST | UCSYNC | UCSSEL_3;
-
-    // Manually adjusting baud rate to 100 kHz  (1MHz / 10 = 100 kHz)
-    UCB1BRW = 10;
-
-    // Set slave address
-    UCB1I2CSA = LM92_ADDRESS;
-
-    // Release reset state
-    UCB1CTLW0 &= ~UCSWRST;
-
-    // Enable receive interrupt
-    UCB1IE |= UCRXIE1;
-    //---------------- End Configure UCB0 I2C -----------
-    send_I2C_data();
+    // Enable receive interrupt; transmit is enabled while a reply is going out
+    UCA1IE |= UCRXIE;
+    //---------------- End Configure UCA1 UART ----------
+    send_I2C_data(CONTROL_ZONE_UI);
 
+    WDTCTL = WATCHDOG_FEED;     // Hardware watchdog runs from here on, fed by the supervisor
     __enable_interrupt();       // Enable Global Interrupts
     PM5CTL0 &= ~LOCKLPM5;       // Clear lock bit
 
@@ -335,22 +521,22 @@ int main(void)
 #pragma vector = TIMER0_B0_VECTOR
 __interrupt void ISR_TB0_SwitchColumn(void)
 {
-    if (state == UNLOCKING)
+    if (keypad.state == UNLOCKING)
     { // If in unlocking state
-        if (mili_seconds_surpassed >= 5000)
+        if (scan.lockout_ms >= 5000)
         {
-            state = LOCKED; // Set to lock state
-            index = 0; // Reset position on input_code
-            mili_seconds_surpassed = 0; // Reset timeout counter
-            send_I2C_data();
+            TRACE_RECORD(TRACE_LOCKOUT, 0, 0);
+            keypad_lock(&keypad); // Set to lock state and reset position in the pass code
+            scan.lockout_ms = 0; // Reset timeout counter
+            send_I2C_data(CONTROL_ZONE_UI);
         }
         else
         {
-            mili_seconds_surpassed++;
+            scan.lockout_ms++;
         }
     }
 
-    switch (column)
+    switch (scan.column)
     {
         case 0:
             P3OUT = 0b00001000; //Enable reading far left column
@@ -367,245 +553,40 @@ __interrupt void ISR_TB0_SwitchColumn(void)
 
     if (P3IN > 15){  // If a button is being pressed
 
-        if (state == LOCKED)
-        {
-            state = UNLOCKING;
-        }
-
         if (P3IN & BIT4)
         {    // If bit 4 is receiving input, we're at row 3, so on and so forth
-            row = 3;
+            scan.row = 3;
         }
         else if (P3IN & BIT5)
         {
-            row = 2;
+            scan.row = 2;
         }
         else if (P3IN & BIT6)
         {
-            row = 1;
+            scan.row = 1;
         }
         else if (P3IN & BIT7)
         {
-            row = 0;
+            scan.row = 0;
         }
 
-        key_pressed = keyPad[row][column];
-
-        switch (state)
-        {
-            case UNLOCKING: // If unlocking, we populate our input code with each pressed key
-                input_code[index] = key_pressed; // Set the input code at index to what is pressed.
-                if (index >= 3)
-                { // If we've entered all four digits of input code:
-                    index = 0;
-                    state = UNLOCKED; // Initially set state to free
-                    mili_seconds_surpassed = 0; // Stop lockout counter
-                    int i;
-                    for (i = 0; i < 4; i++)
-                    { // Iterate through the pass_code and input_code
-                        if (input_code[i] != pass_code[i])
-                        { // If an element in pass_code and input_code doesn't match
-                            state = LOCKED;                   // Set state back to locked.
-                            break;
-                        }
-                    }
-                    send_I2C_data();
-                }
-                else
-                {
-                    index++; // Shift to next index of input code
-                }
-
-                break;
-            default:     // If unlocked, we check the individual key press.
-                switch (key_pressed)
-                {
-                    case ('A'):
-                        state = HEAT;
-                        if (state != sub_state)
-                        {
-                            timer = 0;
-                        }
-                        sub_state = state;
-                        tx_buffer[0] = 0;
-                        break;
-                    case ('B'):
-                        state = COOL;
-                        if (state != sub_state)
-                        {
-                            timer = 0;
-                        }
-                        sub_state = state;
-                        tx_buffer[0] = 1;
-                        break;
-                    case ('C'):
-                        state = MATCH;
-                        if (state != sub_state)
-                        {
-                            timer = 0;
-                        }
-                        sub_state = state;
-                        tx_buffer[0] = 3;
-                        break;
-                    case ('D'):
-                        state = OFF;
-                        if (state != sub_state)
-                        {
-                            timer = 0;
-                        }
-                        sub_state = state;
-                        tx_buffer[0] = 2;
-                        break;
-                    case ('0'):
-                         state = SET_WINDOW;
-                        break;
-                    case ('1'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 1;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 1;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('2'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 2;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 2;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('3'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 3;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 3;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('4'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 4;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 4;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('5'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 5;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 5;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('6'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 6;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 6;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('7'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 7;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 7;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('8'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 8;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 8;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('9'):
-                        if (state == SET_WINDOW)
-                        {
-                            window_size = 9;
-                            state = sub_state;
-                            tx_buffer[5] = window_size;
-                        }
-                        else if (state == SET_TEMP)
-                        {
-                            temp_match = 9;
-                            state = sub_state;
-                        }
-                        break;
-                    case ('*'):
-                        state = SET_TEMP;
-                        break;
-                    case ('#'):
-                        state = MATCH_SET;
-                        if (state != sub_state)
-                        {
-                            timer = 0;
-                        }
-                        sub_state = state;
-                        tx_buffer[0] = 4;
-                        break;
-                    default:
-                        break;
-                }
-                break;
+        if (!scan.key_held)
+        { // A press acts once; the scan stays on this column until the key is released
+            scan.key_held = 1;
+            TRACE_RECORD(TRACE_KEY, scan.row * 4 + scan.column, 0);
+            keypad_dispatch(&keypad, scan.row * 4 + scan.column);
+            keypad_events();
         }
-        while (P3IN > 15)
-        {
-
-        } // Wait until button is released
-        send_I2C_data();
     }
     if (P3IN < 16)
     { // Checks if pins 7 - 4 are on, that means a button is being held down; don't shift columns
-        if (++column >= 4)
+        scan.key_held = 0;
+        if (++scan.column >= 4)
         {
-            column = 0;
+            scan.column = 0;
         } // Add one to column, if it's 4 reset back to 0.
     }
+    supervisor_alive(&supervisor, SUPERVISOR_KEYPAD);
     TB0CCTL0 &= ~TBIFG;
 }
 //---------------- End ISR_TB0_SwitchColumn -------------
@@ -617,49 +598,90 @@ __interrupt void ISR_TB1_Heartbeat(void)
 {
     P1OUT ^= BIT0;               //Toggle P1.0(LED1)
     P6OUT ^= BIT6;               //Toggle P6.6(LED2)
-    if (heat == 1)
-    {
-        pattern = (1 << (step_pattern_heat + 1)) - 1;
-        step_pattern_heat = (step_pattern_heat + 1) % 8;
-    }
-    if (cool == 1)
-    {
-        pattern = 0xFF << (7 - step_pattern_cool);
-        step_pattern_cool = (step_pattern_cool + 1) % 8;
-    }
-    timer++;
+    TRACE_RECORD(TRACE_SECOND, 0, 0);
+    control_second(&control);
+    TB1CCR0 += HEARTBEAT_PERIOD;
     TB1CCTL0 &= ~CCIFG;          //clear CCR0 flag
 }
 //---------------- END ISR_TB1_Heartbeat ----------------
 
+//---------------- START ISR_TB1_LedFrame ---------------
+// LED animation frame and supervisor tick
+#pragma vector = TIMER1_B1_VECTOR
+__interrupt void ISR_TB1_LedFrame(void)
+{
+    unsigned char missed;
+    int fed;
+
+    switch (__even_in_range(TB1IV, 0x0E))
+    {
+    case 0x02: // CCR1
+        TB1CCR1 += LED_FRAME_PERIOD;
+        leds_frame(&leds);
+        break;
+    case 0x04: // CCR2
+        TB1CCR2 += SUPERVISOR_PERIOD;
+        missed = supervisor_tick(&supervisor);
+        fed = supervisor_healthy(&supervisor);
+        if (missed || !fed)
+        {
+            TRACE_RECORD(TRACE_SUPERVISOR, missed, fed); // Only ticks that change something, to save the log
+        }
+        if (missed)
+        {
+            recover(missed);
+        }
+        if (fed)
+        {
+            WDTCTL = WATCHDOG_FEED;
+        }
+        break;
+    default:
+        break;
+    }
+}
+//---------------- END ISR_TB1_LedFrame -----------------
+
 //---------------- START ISR_TB2_CCR0 -------------------
 // Sample LM19 Temperature
 #pragma vector = TIMER2_B0_VECTOR
 __interrupt void ISR_TB2_CCR0(void)
 {
-    if (state != LOCKED)
+    supervisor_alive(&supervisor, SUPERVISOR_CONTROL);
+    if (keypad.state != LOCKED)
     {
-        start_ADC_conversion();   // LM19 analog read
-        get_lm92_i2c();           // Start LM92 I2C read
-        peltier_control();        // Initiate Peltier Control
+        unsigned char index = zone_next(CONTROL_ZONE_COUNT);
+        TRACE_RECORD(TRACE_TICK, index, 0);
+        acquire_zone(index);      // Start this zone's ADC and LM92 reads; control follows when both are in
     }
 }
 
 #pragma vector = USCI_B0_VECTOR
 __interrupt void USCI_B0_ISR(void)
 {
-    if (UCB0IV == 0x18)
-    { // TXIFG0 triggered
-        if (tx_index < TX_BYTES)
-        {
-            UCB0TXBUF = tx_buffer[tx_index++]; // Load next byte
-        }
-        else
-        {
-            UCB0CTLW0 |= UCTXSTP; // Send stop condition
-            UCB0IE &= ~UCTXIE0;   // Disable TX interrupt after completion
-            tx_index = 0;
-        }
+    switch (__even_in_range(UCB0IV, USCI_I2C_UCBIT9IFG))
+    {
+        case 0x04: // NACKIFG, no display acknowledged
+            UCB0CTLW0 |= UCTXSTP;
+            UCB0IE &= ~(UCTXIE0 | UCNACKIE);
+            display.index = 0;
+            supervisor_done(&supervisor, SUPERVISOR_DISPLAY);
+            break;
+        case 0x18: // TXIFG0 triggered
+            if (display.index < TX_BYTES)
+            {
+                UCB0TXBUF = display.frame[display.index++]; // Load next byte
+            }
+            else
+            {
+                UCB0CTLW0 |= UCTXSTP; // Send stop condition
+                UCB0IE &= ~(UCTXIE0 | UCNACKIE); // Disable TX interrupt after completion
+                display.index = 0;
+                supervisor_done(&supervisor, SUPERVISOR_DISPLAY);
+            }
+            break;
+        default:
+            break;
     }
 }
 
@@ -669,37 +691,30 @@ __interrupt void USCI_B1_ISR(void)
     switch (__even_in_range(UCB1IV, USCI_I2C_UCBIT9IFG))
     {
         case 0x16:
-            lm92_data[lm92_byte_count++] = UCB1RXBUF;
-            if (lm92_byte_count == 1)
+            lm92_rx.data[lm92_rx.count++] = UCB1RXBUF;
+            if (lm92_rx.count == 1)
             {
                 UCB1CTLW0 |= UCTXSTP;  // Send stop after 2nd byte
             }
-            else if (lm92_byte_count == 2)
+            else if (lm92_rx.count == 2)
             {
-                // Convert to temperature
-                int raw_temp = ((lm92_data[0] << 8) | lm92_data[1]) >> 3;
-                float temp_C = raw_temp * 0.0625;  // LM92 resolution
-                lm92_samples[lm92_sample_index++] = (unsigned int)(temp_C * 10); // Store in tenths of a degree
-                if (lm92_samples_collected == 1)
+                TRACE_RECORD(TRACE_LM92, lm92.zone << 1 | lm92.role, lm92_rx.data[0] << 8 | lm92_rx.data[1]);
+                zones[lm92.zone].alarms[lm92.role] = lm92_status(lm92_rx.data);
+                UCB1IE &= ~UCRXIE1;  // Disable RX interrupt
+                if (lm92.roles)
                 {
-                    // Average and store in tx_buffer
-                    int i = 0;
-                    unsigned int sum = 0;
-                    for (i = 0; i < window_size; i++) sum += lm92_samples[i];
-                    unsigned int avg = sum / window_size;
-                    lm92_temperature_integer = avg / 10;
-                    lm92_temperature_decimal = avg % 10;
-                    tx_buffer[3] = lm92_temperature_integer;     // Integer part
-                    tx_buffer[4] = lm92_temperature_decimal;     // Decimal part
+                    UCB1IE |= UCSTPIE;  // Read the zone's next LM92 once the stop is on the bus
                 }
-                if (lm92_sample_index >= window_size)
+                if (zone_sample(&zones[lm92.zone], lm92.epoch, lm92.role, lm92_sixteenths(lm92_rx.data), TB1R))
                 {
-                    lm92_samples_collected = 1;
-                    lm92_sample_index = 0;
+                    pair_done(lm92.zone);
                 }
-                UCB1IE &= ~UCRXIE1;  // Disable RX interrupt
             }
             break;
+        case 0x08: // UCSTPIFG
+            UCB1IE &= ~UCSTPIE;
+            get_lm92_i2c();
+            break;
         default:
             break;
     }
@@ -708,18 +723,56 @@ __interrupt void USCI_B1_ISR(void)
 #pragma vector = ADC_VECTOR
 __interrupt void ADC_ISR(void)
 {
-    // Store the ADC result in the array
-    adc_results[lm19_sample_index] = ADCMEM0;
-    lm19_sample_index++;
+    int counts = ADCMEM0;
 
-    // If we have collected window_size, calculate the average and reset the counter
-    if (lm19_samples_collected == 1)
-        {
-            get_temperature();
-        }
-    if (lm19_sample_index >= window_size)
+    TRACE_RECORD(TRACE_ADC, adc.zone << 1 | adc.role, counts);
+    if (zone_sample(&zones[adc.zone], adc.epoch, adc.role, counts, TB1R))
+    {
+        pair_done(adc.zone);
+    }
+    else if (adc.roles)
     {
-        lm19_samples_collected = 1;
-        lm19_sample_index = 0;
+        start_ADC_conversion(); // Next ADC channel of the same zone
+    }
+}
+
+#pragma vector = USCI_A1_VECTOR
+__interrupt void USCI_A1_ISR(void)
+{
+    int c;
+
+    switch (__even_in_range(UCA1IV, USCI_UART_UCTXCPTIFG))
+    {
+        case 0x02: // UCRXIFG
+            c = UCA1RXBUF;
+            TRACE_RECORD(TRACE_UART, c, 0);
+            if (uart_cmd_receive(&uart, c))
+            {
+                keypad_events();
+                UCA1IE |= UCTXIE; // Send the reply
+            }
+            break;
+        case 0x04: // UCTXIFG
+            if (uart.reply_index >= uart.reply_length)
+            {
+                TRACE_RECORD(TRACE_UART_SENT, 0, 0); // What goes out next depends on when this line finished
+            }
+            c = uart_cmd_transmit(&uart);
+            if (c < 0 && uart_cmd_poll(&uart))
+            {
+                keypad_events(); // A command that arrived during the last reply
+                c = uart_cmd_transmit(&uart);
+            }
+            if (c < 0)
+            {
+                UCA1IE &= ~UCTXIE; // Reply sent
+            }
+            else
+            {
+                UCA1TXBUF = c;
+            }
+            break;
+        default:
+            break;
     }
 }
@@ -0,0 +1,50 @@
+/**
+ * @file
+ * @brief Peltier heat/cool decision logic.
+ */
+
+#include "fixed.h"
+#include "peltier.h"
+
+int peltier_lookahead_s = PELTIER_LOOKAHEAD_S;
+
+/**
+ * Drive towards a target temperature, holding the current drive when already on target.
+ */
+static enum peltier_drive drive_towards(int plate, int target, enum peltier_drive current)
+{
+    if (plate > target)
+    {
+        return PELTIER_COOL;
+    }
+    else if (plate < target)
+    {
+        return PELTIER_HEAT;
+    }
+    return current;
+}
+
+enum peltier_drive peltier_decide(enum State state, int plate, int slope, int ambient, int setpoint,
+                                  enum peltier_drive current)
+{
+    // Slope is per minute; scaling by 1/60 keeps the divide out of the control path
+    int predicted = plate + (int)q16_16_scale((long)slope * peltier_lookahead_s, Q16_16(1.0 / 60));
+
+    switch (state)
+    {
+        case HEAT:
+            return PELTIER_HEAT;
+
+        case COOL:
+            return PELTIER_COOL;
+
+        case MATCH:
+            return drive_towards(predicted, ambient, current);
+
+        case MATCH_SET:
+            return drive_towards(predicted, setpoint, current);
+
+        default:
+            return current;
+    }
+}
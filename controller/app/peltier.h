@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief Peltier heat/cool decision logic.
+ *
+ * The decision is kept free of any register access so the exact same code can be driven by the host-side thermal
+ * plant simulation in sim/. main.c owns the pins and applies whatever drive is returned here.
+ */
+
+#ifndef PELTIER_H
+#define PELTIER_H
+
+#include "app_state.h"
+
+/** Seconds a mode may run before the controller switches the Peltier off. */
+#define PELTIER_TIMEOUT_S 300
+
+/** How far ahead the plate temperature is extrapolated, roughly the plate's dead time plus the averaging lag. */
+#define PELTIER_LOOKAHEAD_S 2
+
+/** Largest lookahead that may be configured at run time, seconds. */
+#define PELTIER_LOOKAHEAD_MAX_S 30
+
+/** Lookahead in use, seconds; PELTIER_LOOKAHEAD_S after reset. */
+extern int peltier_lookahead_s;
+
+/**
+ * What the Peltier is being told to do.
+ */
+enum peltier_drive {PELTIER_OFF, PELTIER_HEAT, PELTIER_COOL};
+
+/**
+ * Decide the Peltier drive for the current state.
+ *
+ * HEAT and COOL drive unconditionally. MATCH drives the plate towards the ambient reading and MATCH_SET drives it
+ * towards the setpoint; when the plate already equals the target the previous drive is kept. Any other state leaves
+ * the drive unchanged as well.
+ *
+ * The target modes act on where the plate will be peltier_lookahead_s from now at its current rate of change, so the
+ * drive is released before the plate's own lag carries it past the target.
+ *
+ * @param: state Current controller state.
+ * @param: plate Plate (LM92) temperature, tenths of a degree C.
+ * @param: slope Plate rate of change, tenths of a degree C per minute.
+ * @param: ambient Ambient (LM19) temperature, tenths of a degree C.
+ * @param: setpoint MATCH_SET target, tenths of a degree C.
+ * @param: current Drive currently applied.
+ *
+ * @return: The drive to apply.
+ */
+enum peltier_drive peltier_decide(enum State state, int plate, int slope, int ambient, int setpoint,
+                                  enum peltier_drive current);
+
+#endif // PELTIER_H
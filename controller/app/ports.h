@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief Register access for modules that are also built on the host.
+ *
+ * On the MSP430 this is just msp430.h. Host builds (sim/) get plain variables with the same names, defined by the host
+ * program, so register-level code runs unchanged and its effect can be inspected.
+ */
+
+#ifndef PORTS_H
+#define PORTS_H
+
+#ifdef __MSP430__
+#include <msp430.h>
+#else
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+extern volatile unsigned char P1OUT;
+extern volatile unsigned char P5OUT;
+extern volatile unsigned char P6OUT;
+#endif
+
+#endif // PORTS_H
@@ -0,0 +1,150 @@
+/**
+ * @file
+ * @brief Running statistics over a sliding window of temperature samples.
+ */
+
+#include "fixed.h"
+#include "stats.h"
+
+/**
+ * Per sample count factors, so the queries multiply instead of dividing. Slope: the least-squares denominator for n
+ * evenly spaced samples is n^2 (n^2 - 1) / 12.
+ */
+#define MEAN_GAIN(n) Q16_16(1.0 / (n))
+#define VARIANCE_GAIN(n) Q16_16(1.0 / ((n) * (n)))
+#define SLOPE_GAIN(n) Q16_16((n) < 2 ? 0.0 : STATS_SAMPLES_PER_MIN * 12.0 / ((n) * (n) * ((n) * (n) - 1.0)))
+#define FOR_EACH_COUNT(f) 0, f(1), f(2), f(3), f(4), f(5), f(6), f(7), f(8), f(9), f(10), f(11), f(12), f(13), f(14), \
+                          f(15), f(16)
+
+static const q16_16_t mean_gain[STATS_WINDOW + 1] = {FOR_EACH_COUNT(MEAN_GAIN)};
+static const q16_16_t variance_gain[STATS_WINDOW + 1] = {FOR_EACH_COUNT(VARIANCE_GAIN)};
+static const q16_16_t slope_gain[STATS_WINDOW + 1] = {FOR_EACH_COUNT(SLOPE_GAIN)};
+
+static void deque_push(const struct stats *stats, unsigned char *deque, unsigned char front, unsigned char *size,
+                       unsigned char slot, int value, int keep_max)
+{
+    // Drop entries from the back that the new sample outlives and beats
+    while (*size > 0)
+    {
+        int back = stats->samples[deque[(front + *size - 1) % STATS_WINDOW]];
+        if (keep_max ? back > value : back < value)
+        {
+            break;
+        }
+        (*size)--;
+    }
+    deque[(front + *size) % STATS_WINDOW] = slot;
+    (*size)++;
+}
+
+/**
+ * Each slot holds one sample of the window, so an entry for the slot about to be overwritten is the oldest sample.
+ */
+static void deque_expire(const unsigned char *deque, unsigned char *front, unsigned char *size, unsigned char oldest)
+{
+    if (*size > 0 && deque[*front] == oldest)
+    {
+        *front = (*front + 1) % STATS_WINDOW;
+        (*size)--;
+    }
+}
+
+void stats_reset(struct stats *stats)
+{
+    stats->head = 0;
+    stats->count = 0;
+    stats->sum_y = 0;
+    stats->sum_yy = 0;
+    stats->sum_xy = 0;
+    stats->max_front = 0;
+    stats->max_size = 0;
+    stats->min_front = 0;
+    stats->min_size = 0;
+}
+
+void stats_push(struct stats *stats, int tenths)
+{
+    unsigned char slot = stats->head;
+
+    if (stats->count == STATS_WINDOW)
+    {
+        int oldest = stats->samples[stats->head];
+
+        // Every remaining sample moves one position towards the start
+        stats->sum_xy -= stats->sum_y - oldest;
+        stats->sum_y -= oldest;
+        stats->sum_yy -= (long)oldest * oldest;
+        deque_expire(stats->max_deque, &stats->max_front, &stats->max_size, slot);
+        deque_expire(stats->min_deque, &stats->min_front, &stats->min_size, slot);
+        stats->count--;
+    }
+
+    stats->samples[stats->head] = tenths;
+    stats->head = (stats->head + 1) % STATS_WINDOW;
+    stats->sum_xy += (long)stats->count * tenths;
+    stats->sum_y += tenths;
+    stats->sum_yy += (long)tenths * tenths;
+    stats->count++;
+
+    deque_push(stats, stats->max_deque, stats->max_front, &stats->max_size, slot, tenths, 1);
+    deque_push(stats, stats->min_deque, stats->min_front, &stats->min_size, slot, tenths, 0);
+}
+
+int stats_min(const struct stats *stats)
+{
+    return stats->min_size ? stats->samples[stats->min_deque[stats->min_front]] : 0;
+}
+
+int stats_max(const struct stats *stats)
+{
+    return stats->max_size ? stats->samples[stats->max_deque[stats->max_front]] : 0;
+}
+
+int stats_mean(const struct stats *stats)
+{
+    return (int)q16_16_scale(stats->sum_y, mean_gain[stats->count]);
+}
+
+long stats_variance(const struct stats *stats)
+{
+    long n = stats->count;
+
+    return q16_16_scale(n * stats->sum_yy - stats->sum_y * stats->sum_y, variance_gain[n]);
+}
+
+int stats_slope(const struct stats *stats)
+{
+    long n = stats->count;
+    long sum_x = (n * (n - 1)) >> 1;
+
+    return (int)fixed_clamp(q16_16_scale(n * stats->sum_xy - sum_x * stats->sum_y, slope_gain[n]), INT16_MIN,
+                            INT16_MAX);
+}
+
+unsigned int stats_eta(const struct stats *stats, int target_tenths)
+{
+    long distance = (long)target_tenths - stats_latest(stats);
+    long slope = stats_slope(stats);
+    long seconds;
+
+    if (distance == 0)
+    {
+        return 0;
+    }
+    if (slope == 0 || (distance > 0) != (slope > 0))
+    {
+        return STATS_ETA_UNKNOWN;
+    }
+    seconds = distance * 60 / slope;
+    return (seconds >= STATS_ETA_UNKNOWN) ? STATS_ETA_UNKNOWN - 1 : (unsigned int)seconds;
+}
+
+int stats_latest(const struct stats *stats)
+{
+    return stats->count ? stats->samples[(stats->head + STATS_WINDOW - 1) % STATS_WINDOW] : 0;
+}
+
+int stats_sample(const struct stats *stats, unsigned char index)
+{
+    return stats->samples[(stats->head + STATS_WINDOW - stats->count + index) % STATS_WINDOW];
+}
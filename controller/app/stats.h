@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Running statistics over a sliding window of temperature samples.
+ *
+ * Every update is O(1): the sums behind the mean, variance and least-squares slope are adjusted for the sample that
+ * enters and the one that leaves, and the window minimum and maximum come from monotonic deques. All math is integer;
+ * temperatures are tenths of a degree C throughout.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#define STATS_WINDOW 16           // Samples in the window, a power of two; the gain tables in stats.c stop at 16
+#define STATS_SAMPLES_PER_MIN 120 // One sample per 0.5 s control period
+#define STATS_ETA_UNKNOWN 0xFFFF  // Not approaching the target, same value as LCD_ETA_UNKNOWN
+
+/**
+ * Window state for one sensor.
+ */
+struct stats
+{
+    /** Samples, oldest at head once full */
+    int samples[STATS_WINDOW];
+
+    /** Next slot to write */
+    unsigned char head;
+
+    /** Samples in the window, up to STATS_WINDOW */
+    unsigned char count;
+
+    /** Sum of samples */
+    long sum_y;
+
+    /** Sum of squared samples */
+    long sum_yy;
+
+    /** Sum of position * sample, position 0 being the oldest sample */
+    long sum_xy;
+
+    /** Monotonic deques of sample slots: values decreasing for max, increasing for min */
+    unsigned char max_deque[STATS_WINDOW];
+    unsigned char min_deque[STATS_WINDOW];
+    unsigned char max_front, max_size;
+    unsigned char min_front, min_size;
+};
+
+/**
+ * Empty the window.
+ *
+ * @param: stats Window to reset.
+ */
+void stats_reset(struct stats *stats);
+
+/**
+ * Add a sample, dropping the oldest once the window is full.
+ *
+ * @param: stats Window.
+ * @param: tenths Sample, tenths of a degree C.
+ */
+void stats_push(struct stats *stats, int tenths);
+
+/**
+ * @return: Smallest sample in the window, 0 when empty.
+ */
+int stats_min(const struct stats *stats);
+
+/**
+ * @return: Largest sample in the window, 0 when empty.
+ */
+int stats_max(const struct stats *stats);
+
+/**
+ * @return: Mean of the window, tenths of a degree C, rounded to nearest.
+ */
+int stats_mean(const struct stats *stats);
+
+/**
+ * @return: Population variance of the window, square tenths of a degree C, to within 0.1%.
+ */
+long stats_variance(const struct stats *stats);
+
+/**
+ * Least-squares slope of the window.
+ *
+ * @return: Rate of change, tenths of a degree C per minute, to within 0.05%; 0 with fewer than two samples.
+ */
+int stats_slope(const struct stats *stats);
+
+/**
+ * Extrapolate the current slope to a target.
+ *
+ * @param: stats Window.
+ * @param: target_tenths Target, tenths of a degree C.
+ *
+ * @return: Seconds until the latest sample reaches the target, or STATS_ETA_UNKNOWN if it is not moving towards it.
+ */
+unsigned int stats_eta(const struct stats *stats, int target_tenths);
+
+/**
+ * @return: The newest sample, 0 when empty.
+ */
+int stats_latest(const struct stats *stats);
+
+/**
+ * A sample from the window, oldest first.
+ *
+ * @param: stats Window.
+ * @param: index 0 for the oldest sample, up to the sample count - 1.
+ *
+ * @return: Sample, tenths of a degree C.
+ */
+int stats_sample(const struct stats *stats, unsigned char index);
+
+#endif // STATS_H
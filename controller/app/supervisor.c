@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief Software watchdog for the controller's subsystems.
+ */
+
+#include "supervisor.h"
+
+void supervisor_init(struct supervisor *supervisor, const struct supervisor_deadline *deadlines)
+{
+    unsigned char task;
+
+    supervisor->deadlines = deadlines;
+    for (task = 0; task < SUPERVISOR_TASKS; task++)
+    {
+        supervisor->elapsed[task] = 0;
+        supervisor->armed[task] = 0;
+        supervisor->strikes[task] = 0;
+    }
+}
+
+void supervisor_start(struct supervisor *supervisor, enum supervisor_task task)
+{
+    supervisor->elapsed[task] = 0;
+    supervisor->armed[task] = 1;
+}
+
+void supervisor_done(struct supervisor *supervisor, enum supervisor_task task)
+{
+    supervisor->armed[task] = 0;
+    supervisor->strikes[task] = 0;
+}
+
+void supervisor_alive(struct supervisor *supervisor, enum supervisor_task task)
+{
+    supervisor->elapsed[task] = 0;
+    supervisor->armed[task] = 1;
+    supervisor->strikes[task] = 0;
+}
+
+unsigned char supervisor_tick(struct supervisor *supervisor)
+{
+    unsigned char missed = 0;
+    unsigned char task;
+
+    for (task = 0; task < SUPERVISOR_TASKS; task++)
+    {
+        if (!supervisor->armed[task] || ++supervisor->elapsed[task] < supervisor->deadlines[task].ticks)
+        {
+            continue;
+        }
+        missed |= 1 << task;
+        supervisor->elapsed[task] = 0;
+        supervisor->armed[task] = supervisor->deadlines[task].periodic;
+        if (supervisor->strikes[task] <= SUPERVISOR_RETRIES)
+        {
+            supervisor->strikes[task]++;
+        }
+    }
+    return missed;
+}
+
+int supervisor_healthy(const struct supervisor *supervisor)
+{
+    unsigned char task;
+
+    for (task = 0; task < SUPERVISOR_TASKS; task++)
+    {
+        if (supervisor->strikes[task] > SUPERVISOR_RETRIES)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
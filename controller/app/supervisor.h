@@ -0,0 +1,109 @@
+/**
+ * @file
+ * @brief Software watchdog for the controller's subsystems.
+ *
+ * Each subsystem has its own deadline, counted in supervisor ticks. Periodic subsystems (control, keypad scan) must
+ * report alive within their deadline every time; one-shot operations (a zone's sensor reads, a display frame) are
+ * started and must be reported done within their deadline. A missed deadline is reported once per deadline so the
+ * caller can turn the Peltiers off and try a targeted recovery, and counts as a strike against the subsystem.
+ *
+ * The hardware watchdog is fed only while supervisor_healthy(): once any subsystem has missed SUPERVISOR_RETRIES
+ * deadlines in a row without recovering, feeding stops and the watchdog resets the board. If the CPU is stuck and the
+ * supervisor tick itself stops, feeding stops with it.
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#define SUPERVISOR_RETRIES 2 // Recoveries tried before the watchdog is left to reset the board
+
+/**
+ * Supervised subsystems.
+ */
+enum supervisor_task {SUPERVISOR_ACQUISITION, SUPERVISOR_CONTROL, SUPERVISOR_DISPLAY, SUPERVISOR_KEYPAD,
+                      SUPERVISOR_TASKS};
+
+/**
+ * Deadline of one subsystem.
+ */
+struct supervisor_deadline
+{
+    /** Supervisor ticks allowed between start or alive and done or alive */
+    unsigned char ticks;
+
+    /** Non-zero if the subsystem reports alive periodically, zero for one-shot operations */
+    unsigned char periodic;
+};
+
+/**
+ * Supervisor state.
+ */
+struct supervisor
+{
+    /** Deadlines, indexed by enum supervisor_task */
+    const struct supervisor_deadline *deadlines;
+
+    /** Ticks since the deadline was armed */
+    unsigned char elapsed[SUPERVISOR_TASKS];
+
+    /** Non-zero while a deadline is running */
+    unsigned char armed[SUPERVISOR_TASKS];
+
+    /** Deadlines missed since the subsystem last succeeded */
+    unsigned char strikes[SUPERVISOR_TASKS];
+};
+
+/**
+ * Start with no deadline running and no strikes. Periodic subsystems are armed by their first supervisor_alive().
+ *
+ * @param: supervisor Supervisor to initialise.
+ * @param: deadlines SUPERVISOR_TASKS deadlines.
+ */
+void supervisor_init(struct supervisor *supervisor, const struct supervisor_deadline *deadlines);
+
+/**
+ * A one-shot operation has started; it must be done within its deadline.
+ *
+ * @param: supervisor Supervisor.
+ * @param: task Subsystem.
+ */
+void supervisor_start(struct supervisor *supervisor, enum supervisor_task task);
+
+/**
+ * A one-shot operation has finished. Clears the subsystem's strikes.
+ *
+ * @param: supervisor Supervisor.
+ * @param: task Subsystem.
+ */
+void supervisor_done(struct supervisor *supervisor, enum supervisor_task task);
+
+/**
+ * A periodic subsystem has run. Restarts its deadline and clears its strikes.
+ *
+ * @param: supervisor Supervisor.
+ * @param: task Subsystem.
+ */
+void supervisor_alive(struct supervisor *supervisor, enum supervisor_task task);
+
+/**
+ * Advance every running deadline by one tick.
+ *
+ * A one-shot operation that misses its deadline is abandoned; a periodic subsystem stays armed and misses again a
+ * deadline later if it still has not run.
+ *
+ * @param: supervisor Supervisor.
+ *
+ * @return: Bit (1 << task) set for each subsystem that missed its deadline on this tick.
+ */
+unsigned char supervisor_tick(struct supervisor *supervisor);
+
+/**
+ * Whether the hardware watchdog may be fed.
+ *
+ * @param: supervisor Supervisor.
+ *
+ * @return: 1 if no subsystem has missed more than SUPERVISOR_RETRIES deadlines in a row, 0 otherwise.
+ */
+int supervisor_healthy(const struct supervisor *supervisor);
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief Input event trace for deterministic replay.
+ */
+
+#include "trace.h"
+
+void trace_start(struct trace_log *log)
+{
+    log->magic = TRACE_MAGIC;
+    log->count = 0;
+}
+
+void trace_record(struct trace_log *log, uint16_t time, uint8_t type, uint8_t arg, uint16_t value)
+{
+    struct trace_event *event;
+
+    if (log->count >= TRACE_EVENTS)
+    {
+        return;
+    }
+    event = &log->events[log->count++];
+    event->time = time;
+    event->type = type;
+    event->arg = arg;
+    event->value = value;
+}
+
+void trace_event_write(const struct trace_event *event, unsigned char *bytes)
+{
+    bytes[0] = event->time & 0xFF;
+    bytes[1] = event->time >> 8;
+    bytes[2] = event->type;
+    bytes[3] = event->arg;
+    bytes[4] = event->value & 0xFF;
+    bytes[5] = event->value >> 8;
+}
+
+void trace_event_read(const unsigned char *bytes, struct trace_event *event)
+{
+    event->time = bytes[0] | (bytes[1] << 8);
+    event->type = bytes[2];
+    event->arg = bytes[3];
+    event->value = bytes[4] | (bytes[5] << 8);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file
+ * @brief Input event trace for deterministic replay.
+ *
+ * Everything the controller acts on arrives through an interrupt: ADC results, LM92 bytes, key presses, UART bytes, the
+ * end of each UART reply line, timer ticks and the supervisor's missed deadlines. Built with TRACE defined, main.c
+ * records each of these inputs in arrival order, from reset until the log is full, together with the TB1 count at which
+ * it arrived. Feeding the same events through the same modules in the same order reproduces every frame, actuator
+ * change and UART reply, which is what sim/trace_replay.c does.
+ *
+ * The log is kept in FRAM so that it survives a halt or a crash until it is read out with the debugger. Its memory
+ * image is the trace file: TRACE_HEADER_BYTES of header (magic, event count) followed by TRACE_EVENT_BYTES per event,
+ * all 16-bit fields little endian.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC 0x5254       // "TR" in a little endian dump
+#define TRACE_EVENTS 1024        // About two and a half minutes of one zone, 6 KB of FRAM
+#define TRACE_HEADER_BYTES 4
+#define TRACE_EVENT_BYTES 6
+
+/**
+ * Kind of input. arg and value of a trace_event depend on it.
+ */
+enum trace_type
+{
+    TRACE_ADC = 1,    // arg: zone << 1 | role, value: ADC counts
+    TRACE_LM92,       // arg: zone << 1 | role, value: temperature register, first byte high
+    TRACE_KEY,        // arg: key code
+    TRACE_TICK,       // arg: zone serviced by the control tick
+    TRACE_SECOND,     // Heartbeat, advances the mode timer
+    TRACE_UART,       // arg: received character
+    TRACE_LOCKOUT,    // Pass code entry timed out
+    TRACE_SUPERVISOR, // arg: deadlines missed, 1 << enum supervisor_task each, value: 1 if the watchdog was fed
+    TRACE_UART_SENT,  // Last reply line out: the next line of a stream or a command held meanwhile starts
+};
+
+/**
+ * One recorded input.
+ */
+struct trace_event
+{
+    /** TB1 count (ACLK, 32768 Hz, wraps every 2 s) when the input arrived */
+    uint16_t time;
+
+    /** enum trace_type */
+    uint8_t type;
+
+    /** Type specific argument */
+    uint8_t arg;
+
+    /** Type specific value */
+    uint16_t value;
+};
+
+/**
+ * Trace log, in the layout of the trace file.
+ */
+struct trace_log
+{
+    /** TRACE_MAGIC once started */
+    uint16_t magic;
+
+    /** Events recorded */
+    uint16_t count;
+
+    /** Events in arrival order */
+    struct trace_event events[TRACE_EVENTS];
+};
+
+/**
+ * Empty the log.
+ *
+ * @param: log Log to start.
+ */
+void trace_start(struct trace_log *log);
+
+/**
+ * Append an event. Events arriving once the log is full are dropped, so a replay always starts from reset.
+ *
+ * Not reentrant; the firmware calls it from interrupts, which do not nest.
+ *
+ * @param: log Log.
+ * @param: time Arrival time, TB1 counts.
+ * @param: type enum trace_type.
+ * @param: arg Type specific argument.
+ * @param: value Type specific value.
+ */
+void trace_record(struct trace_log *log, uint16_t time, uint8_t type, uint8_t arg, uint16_t value);
+
+/**
+ * Write an event in the file layout.
+ *
+ * @param: event Event.
+ * @param: bytes Buffer of TRACE_EVENT_BYTES.
+ */
+void trace_event_write(const struct trace_event *event, unsigned char *bytes);
+
+/**
+ * Read an event from the file layout.
+ *
+ * @param: bytes TRACE_EVENT_BYTES of a trace file.
+ * @param: event Event to fill.
+ */
+void trace_event_read(const unsigned char *bytes, struct trace_event *event);
+
+#endif // TRACE_H
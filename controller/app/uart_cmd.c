@@ -0,0 +1,464 @@
+/**
+ * @file
+ * @brief Line-based command and query interface for the eUSCI_A UART.
+ */
+
+#include "fixed.h"
+#include "uart_cmd.h"
+
+// Longest Q reply: the longest state and drive names, and each field at the widest value its type, or for gain and
+// window its command, allows. Latencies are an unsigned int of ACLK counts in microseconds, at most 1999969.
+#define QUERY_FIELD(name, digits) (sizeof(" " name "=") - 1 + (digits))
+#define QUERY_REPLY_MAX                                                                                                \
+    (sizeof("OK mode=UNLOCKING") - 1 + QUERY_FIELD("plate", 6) + QUERY_FIELD("ambient", 6) +                           \
+     QUERY_FIELD("setpoint", 6) + QUERY_FIELD("target", 6) + QUERY_FIELD("window", 2) + QUERY_FIELD("drive", 4) +     \
+     QUERY_FIELD("slope", 6) + QUERY_FIELD("eta", 5) + QUERY_FIELD("min", 6) + QUERY_FIELD("max", 6) +                \
+     QUERY_FIELD("var", 11) + QUERY_FIELD("gain", 2) + QUERY_FIELD("lat", 7) + QUERY_FIELD("lat_max", 7) +            \
+     QUERY_FIELD("alarm", 3))
+
+typedef char query_reply_fits[(QUERY_REPLY_MAX <= UART_CMD_REPLY_MAX - 2) ? 1 : -1]; // Room is kept for CR LF
+
+/**
+ * Names for every state, as queries report them; the Peltier modes double as the M command arguments.
+ */
+static const char *const state_names[SET_WINDOW + 1] = {
+    [LOCKED] = "LOCKED", [UNLOCKING] = "UNLOCKING", [UNLOCKED] = "UNLOCKED", [OFF] = "OFF", [HEAT] = "HEAT",
+    [COOL] = "COOL", [MATCH] = "MATCH", [MATCH_SET] = "SET", [SET_TEMP] = "ENTRY", [SET_WINDOW] = "ENTRY",
+};
+
+static const char *const drive_names[] = {
+    [PELTIER_OFF] = "OFF", [PELTIER_HEAT] = "HEAT", [PELTIER_COOL] = "COOL",
+};
+
+/**
+ * Energy field names, indexed like energy_meter.updates.
+ */
+static const char *const energy_names[ENERGY_MODES] = {"off", "heat", "cool", "match", "set"};
+
+static void reply_text(struct uart_cmd *cmd, const char *text)
+{
+    while (*text != '\0' && cmd->reply_length < UART_CMD_REPLY_MAX - 2) // Room is kept for CR LF
+    {
+        cmd->reply[cmd->reply_length++] = *text++;
+    }
+}
+
+/**
+ * Append a decimal number. Digits come from fixed_format(), so the RX interrupt runs no divide routine; only values
+ * that do not fit 16 bits take the 32-bit subtractions.
+ */
+static void reply_number(struct uart_cmd *cmd, long value)
+{
+    char digits[FIXED_LONG_DIGITS_MAX];
+    unsigned char first = 0;
+    unsigned char count = FIXED_DIGITS_MAX;
+    unsigned long magnitude = (value < 0) ? -(unsigned long)value : (unsigned long)value;
+
+    if (magnitude <= 0xFFFF)
+    {
+        fixed_format(digits, (uint16_t)magnitude, FIXED_DIGITS_MAX);
+    }
+    else
+    {
+        fixed_format_long(digits, (uint32_t)magnitude, FIXED_LONG_DIGITS_MAX);
+        count = FIXED_LONG_DIGITS_MAX;
+    }
+    while (first < count - 1 && digits[first] == '0')
+    {
+        first++; // Leading zeros
+    }
+
+    if (value < 0 && cmd->reply_length < UART_CMD_REPLY_MAX - 2)
+    {
+        cmd->reply[cmd->reply_length++] = '-';
+    }
+    while (first < count && cmd->reply_length < UART_CMD_REPLY_MAX - 2)
+    {
+        cmd->reply[cmd->reply_length++] = digits[first++];
+    }
+}
+
+/**
+ * Append " name=value".
+ */
+static void reply_field(struct uart_cmd *cmd, const char *name, long value)
+{
+    reply_text(cmd, " ");
+    reply_text(cmd, name);
+    reply_text(cmd, "=");
+    reply_number(cmd, value);
+}
+
+static void reply_end(struct uart_cmd *cmd)
+{
+    cmd->reply[cmd->reply_length++] = '\r';
+    cmd->reply[cmd->reply_length++] = '\n';
+    cmd->reply_index = 0;
+}
+
+static void reply_error(struct uart_cmd *cmd, const char *reason)
+{
+    reply_text(cmd, "ERR ");
+    reply_text(cmd, reason);
+}
+
+/**
+ * Parse an optionally signed decimal argument that runs to the end of the line.
+ *
+ * @return: 0 on success, -1 if there is no number or anything follows it.
+ */
+static int parse_number(const char *text, int *value)
+{
+    int negative = 0;
+    int digits = 0;
+    long result = 0;
+
+    if (*text == '-')
+    {
+        negative = 1;
+        text++;
+    }
+    while (*text >= '0' && *text <= '9')
+    {
+        result = result * 10 + (*text - '0');
+        if (result > 32767)
+        {
+            result = 32767; // Out of range for every command, and must not wrap into range as an int
+        }
+        text++;
+        digits++;
+    }
+    if (digits == 0 || *text != '\0')
+    {
+        return -1;
+    }
+    *value = (int)(negative ? -result : result);
+    return 0;
+}
+
+static int text_equals(const char *a, const char *b)
+{
+    while (*a != '\0' && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static int unlocked(const struct uart_cmd *cmd)
+{
+    return cmd->keypad->state != LOCKED && cmd->keypad->state != UNLOCKING;
+}
+
+/**
+ * Feed the pass code digits through the keypad's code entry, exactly as key presses would. The argument must be exactly
+ * KEYPAD_CODE_LENGTH digits, so each command is one attempt at the code.
+ */
+static void command_unlock(struct uart_cmd *cmd, const char *argument)
+{
+    unsigned char i;
+
+    if (unlocked(cmd))
+    {
+        reply_text(cmd, "OK");
+        return;
+    }
+    for (i = 0; i < KEYPAD_CODE_LENGTH; i++)
+    {
+        if (argument[i] < '0' || argument[i] > '9')
+        {
+            reply_error(cmd, "SYNTAX"); // Only the digit keys are allowed in a code, and the terminator stops here too
+            return;
+        }
+    }
+    if (argument[KEYPAD_CODE_LENGTH] != '\0')
+    {
+        reply_error(cmd, "SYNTAX");
+        return;
+    }
+    keypad_lock(cmd->keypad); // Discard any digits already typed on the keypad
+    for (i = 0; i < KEYPAD_CODE_LENGTH; i++)
+    {
+        keypad_dispatch(cmd->keypad, (unsigned char)keypad_key(argument[i]));
+    }
+    cmd->keypad->events |= KEYPAD_EVENT_CODE_ENTERED;
+    if (cmd->keypad->state == UNLOCKED)
+    {
+        reply_text(cmd, "OK");
+    }
+    else
+    {
+        keypad_lock(cmd->keypad);
+        reply_error(cmd, "CODE");
+    }
+}
+
+static void command_mode(struct uart_cmd *cmd, const char *argument)
+{
+    int mode;
+
+    for (mode = OFF; mode <= MATCH_SET; mode++)
+    {
+        if (text_equals(argument, state_names[mode]))
+        {
+            keypad_select(cmd->keypad, (enum State)mode);
+            reply_text(cmd, "OK");
+            return;
+        }
+    }
+    reply_error(cmd, "SYNTAX");
+}
+
+static void command_query(struct uart_cmd *cmd, unsigned char index)
+{
+    const struct zone *zone = &cmd->zones[index];
+    const struct stats *plate = &zone->stats[ZONE_PLATE];
+
+    reply_text(cmd, "OK mode=");
+    reply_text(cmd, state_names[(index == 0) ? cmd->keypad->state : zone->mode]);
+    reply_field(cmd, "plate", zone->tenths[ZONE_PLATE]);
+    reply_field(cmd, "ambient", zone->tenths[ZONE_AMBIENT]);
+    reply_field(cmd, "setpoint", (index == 0) ? cmd->keypad->setpoint_tenths : zone->setpoint_tenths);
+    reply_field(cmd, "target", zone_target(zone));
+    reply_field(cmd, "window", cmd->keypad->window_size);
+    reply_text(cmd, " drive=");
+    reply_text(cmd, drive_names[zone->drive]);
+    reply_field(cmd, "slope", stats_slope(plate));
+    reply_field(cmd, "eta", stats_eta(plate, zone_target(zone)));
+    reply_field(cmd, "min", stats_min(plate));
+    reply_field(cmd, "max", stats_max(plate));
+    reply_field(cmd, "var", stats_variance(plate));
+    reply_field(cmd, "gain", peltier_lookahead_s);
+    reply_field(cmd, "lat", ((unsigned long)zone->latency * 15625) >> 9); // ACLK counts to microseconds
+    reply_field(cmd, "lat_max", ((unsigned long)zone->latency_max * 15625) >> 9);
+    reply_field(cmd, "alarm", zone->alarms[ZONE_PLATE] | zone->alarms[ZONE_AMBIENT]);
+}
+
+static void command_energy(struct uart_cmd *cmd, unsigned char index)
+{
+    const struct zone *zone = &cmd->zones[index];
+    unsigned char mode;
+
+    reply_text(cmd, "OK");
+    for (mode = 0; mode < ENERGY_MODES; mode++)
+    {
+        reply_field(cmd, energy_names[mode], energy_joules(zone->budget, zone->energy.updates[mode]));
+    }
+    reply_field(cmd, "mode", energy_joules(zone->budget, zone->energy.mode_updates));
+    reply_field(cmd, "avg", zone->budget->average_w);
+    reply_field(cmd, "peak", zone->budget->peak_ma);
+}
+
+/**
+ * Format the next line of an H command, without its line end: one role's window per line, then the final OK.
+ */
+static void stream_next(struct uart_cmd *cmd)
+{
+    const struct zone *zone = &cmd->zones[cmd->stream_zone];
+    int role = (cmd->stream_lines == 3) ? ZONE_PLATE : ZONE_AMBIENT;
+    unsigned char i;
+
+    cmd->reply_length = 0;
+    if (--cmd->stream_lines == 0)
+    {
+        reply_text(cmd, "OK");
+    }
+    else
+    {
+        reply_text(cmd, (role == ZONE_PLATE) ? "H plate" : "H ambient");
+        for (i = 0; i < zone->stats[role].count; i++)
+        {
+            reply_text(cmd, " ");
+            reply_number(cmd, stats_sample(&zone->stats[role], i));
+        }
+    }
+}
+
+/**
+ * Run the complete line in cmd->line and format its reply.
+ */
+static void execute(struct uart_cmd *cmd)
+{
+    const char *argument = cmd->line + 1;
+    int value = 0;
+    int has_value;
+
+    cmd->line[cmd->length] = '\0';
+    cmd->keypad->events = 0;
+    cmd->reply_length = 0;
+    cmd->pending = 0;
+
+    while (*argument == ' ')
+    {
+        argument++;
+    }
+    has_value = parse_number(argument, &value) == 0;
+
+    if (cmd->overflow)
+    {
+        reply_error(cmd, "LONG");
+    }
+    else if (*argument != '\0' && cmd->line[0] != 'U' && cmd->line[0] != 'M' && !has_value)
+    {
+        reply_error(cmd, "SYNTAX");
+    }
+    else if ((cmd->line[0] == 'T' || cmd->line[0] == 'W' || cmd->line[0] == 'G' || cmd->line[0] == 'P') && !has_value)
+    {
+        reply_error(cmd, "SYNTAX"); // These need an argument; Q, H and E default to zone 0
+    }
+    else if ((cmd->line[0] == 'Q' || cmd->line[0] == 'H' || cmd->line[0] == 'E') &&
+             (value < 0 || value >= cmd->zone_count))
+    {
+        reply_error(cmd, "ZONE");
+    }
+    else if (cmd->line[0] != 'U' && cmd->line[0] != 'Q' && cmd->line[0] != 'H' && cmd->line[0] != 'E' &&
+             !unlocked(cmd))
+    {
+        reply_error(cmd, "LOCKED");
+    }
+    else
+    {
+        switch (cmd->line[0])
+        {
+            case 'U':
+                command_unlock(cmd, argument);
+                break;
+
+            case 'L':
+                keypad_lock(cmd->keypad);
+                reply_text(cmd, "OK");
+                break;
+
+            case 'M':
+                command_mode(cmd, argument);
+                break;
+
+            case 'T':
+                reply_text(cmd, (keypad_set_setpoint(cmd->keypad, value) == 0) ? "OK" : "ERR RANGE");
+                break;
+
+            case 'W':
+                reply_text(cmd, (keypad_set_window(cmd->keypad, value) == 0) ? "OK" : "ERR RANGE");
+                break;
+
+            case 'G':
+                if (value >= 0 && value <= PELTIER_LOOKAHEAD_MAX_S)
+                {
+                    peltier_lookahead_s = value;
+                    reply_text(cmd, "OK");
+                }
+                else
+                {
+                    reply_error(cmd, "RANGE");
+                }
+                break;
+
+            case 'P':
+                if (energy_set_average(cmd->zones[0].budget, value) == 0)
+                {
+                    reply_text(cmd, "OK");
+                }
+                else
+                {
+                    reply_error(cmd, "RANGE");
+                }
+                break;
+
+            case 'Q':
+                command_query(cmd, (unsigned char)value);
+                break;
+
+            case 'E':
+                command_energy(cmd, (unsigned char)value);
+                break;
+
+            case 'H':
+                cmd->stream_zone = (unsigned char)value;
+                cmd->stream_lines = 3;
+                stream_next(cmd);
+                break;
+
+            default:
+                reply_error(cmd, "SYNTAX");
+                break;
+        }
+    }
+
+    reply_end(cmd);
+    cmd->length = 0;
+    cmd->overflow = cmd->discarded; // Characters dropped while this line was held belong to the next one
+    cmd->discarded = 0;
+}
+
+void uart_cmd_init(struct uart_cmd *cmd, struct keypad_fsm *keypad, const struct zone *zones,
+                   unsigned char zone_count)
+{
+    cmd->length = 0;
+    cmd->overflow = 0;
+    cmd->pending = 0;
+    cmd->discarded = 0;
+    cmd->reply_length = 0;
+    cmd->reply_index = 0;
+    cmd->stream_lines = 0;
+    cmd->stream_zone = 0;
+    cmd->keypad = keypad;
+    cmd->zones = zones;
+    cmd->zone_count = zone_count;
+}
+
+int uart_cmd_receive(struct uart_cmd *cmd, char c)
+{
+    if (cmd->pending)
+    {
+        cmd->discarded = 1; // No room until the held line has run
+        return 0;
+    }
+    if (c == '\r' || c == '\n')
+    {
+        if (cmd->length == 0 && !cmd->overflow)
+        {
+            return 0; // Blank line, or the LF of a CR LF pair
+        }
+        if (cmd->reply_index < cmd->reply_length || cmd->stream_lines != 0)
+        {
+            cmd->pending = 1;
+            return 0;
+        }
+        execute(cmd);
+        return 1;
+    }
+    if (cmd->length < UART_CMD_LINE_MAX - 1)
+    {
+        cmd->line[cmd->length++] = c;
+    }
+    else
+    {
+        cmd->overflow = 1;
+    }
+    return 0;
+}
+
+int uart_cmd_transmit(struct uart_cmd *cmd)
+{
+    if (cmd->reply_index >= cmd->reply_length)
+    {
+        if (cmd->stream_lines == 0)
+        {
+            return -1;
+        }
+        stream_next(cmd);
+        reply_end(cmd);
+    }
+    return (unsigned char)cmd->reply[cmd->reply_index++];
+}
+
+int uart_cmd_poll(struct uart_cmd *cmd)
+{
+    if (!cmd->pending || cmd->reply_index < cmd->reply_length || cmd->stream_lines != 0)
+    {
+        return 0;
+    }
+    execute(cmd);
+    return 1;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Line-based command and query interface for the eUSCI_A UART.
+ *
+ * Bytes are fed in one at a time from the RX interrupt and replies are pulled out one byte at a time from the TX
+ * interrupt, so nothing here ever waits on the UART. A command runs as soon as its line ends; the work per command is
+ * bounded by the line length and the reply length, never by what else the controller is doing.
+ *
+ * Commands are one upper case letter, an optional argument, and CR or LF. Every command gets exactly one reply line,
+ * "OK ..." or "ERR <reason>", except H which streams its history lines before the final "OK". Commands that change
+ * the controller go through the keypad state machine, so they follow the same rules as key presses: nothing but U and
+ * the queries is accepted while locked, and a mode change abandons an unfinished keypad entry.
+ *
+ *  - U <code>     Enter the pass code, e.g. "U 2659". Exactly KEYPAD_CODE_LENGTH digits, one attempt per command.
+ *  - L            Lock. Control stops while locked, so every zone's outputs are turned off.
+ *  - M <mode>     Select OFF, HEAT, COOL, MATCH or SET (MATCH_SET).
+ *  - T <tenths>   MATCH_SET setpoint in tenths of a degree C, 0 - SETPOINT_MAX_TENTHS, e.g. "T 255" for 25.5 C.
+ *  - W <samples>  Boxcar window, 1 - WINDOW_MAX.
+ *  - G <seconds>  Control lookahead, 0 - PELTIER_LOOKAHEAD_MAX_S.
+ *  - P <watts>    Average Peltier power budget for all zones, 0 - ENERGY_AVERAGE_MAX_W, 0 for no limit.
+ *  - Q [zone]     Query mode, temperatures (tenths), window, drive, plate slope, time to target, plate statistics,
+ *                 the last and largest sample-to-output latency in microseconds and the LM92 alarm flags
+ *                 (LM92_STATUS_ bits of both sensors; T_CRIT holds the zone's outputs off).
+ *                 Zone 0 reports the keypad's mode and setpoint at once; target and drive follow at the next control
+ *                 update.
+ *  - H [zone]     Stream the plate and ambient statistics windows, oldest sample first.
+ *  - E [zone]     Energy used per Peltier mode and since the current mode was selected, joules, and the power budget
+ *                 (average watts, peak mA).
+ *
+ * Errors: SYNTAX (unknown command, bad argument or T, W, G or P without one), RANGE, LOCKED, CODE (wrong pass code),
+ * ZONE, LONG (line did not fit UART_CMD_LINE_MAX).
+ */
+
+#ifndef UART_CMD_H
+#define UART_CMD_H
+
+#include "keypad.h"
+#include "zone.h"
+
+#define UART_CMD_LINE_MAX 24   // Longest command line, including the terminator
+#define UART_CMD_REPLY_MAX 208 // Longest reply line, including CR LF; uart_cmd.c checks the longest Q fits
+
+/**
+ * Command interface context.
+ */
+struct uart_cmd
+{
+    /** Line being received */
+    char line[UART_CMD_LINE_MAX];
+
+    /** Characters in line */
+    unsigned char length;
+
+    /** Non-zero if the line being received did not fit */
+    unsigned char overflow;
+
+    /** Non-zero while a complete line waits for the previous reply to go out */
+    unsigned char pending;
+
+    /** Non-zero if characters were dropped while a line was held; the line they belong to is answered LONG */
+    unsigned char discarded;
+
+    /** Reply being sent */
+    char reply[UART_CMD_REPLY_MAX];
+
+    /** Characters in reply */
+    unsigned char reply_length;
+
+    /** Next reply character to send */
+    unsigned char reply_index;
+
+    /** History lines of an H command still to be sent, plus one for the final OK */
+    unsigned char stream_lines;
+
+    /** Zone being streamed */
+    unsigned char stream_zone;
+
+    /** Keypad state machine the commands act through */
+    struct keypad_fsm *keypad;
+
+    /** Zones that can be queried; zone 0 follows the keypad */
+    const struct zone *zones;
+
+    /** Number of zones */
+    unsigned char zone_count;
+};
+
+/**
+ * Set up an idle interface.
+ *
+ * @param: cmd Context to initialise.
+ * @param: keypad State machine that mode, setpoint and window commands go through.
+ * @param: zones Zone table for queries.
+ * @param: zone_count Entries in zones.
+ */
+void uart_cmd_init(struct uart_cmd *cmd, struct keypad_fsm *keypad, const struct zone *zones,
+                   unsigned char zone_count);
+
+/**
+ * Take one received character, running the command when its line ends.
+ *
+ * keypad->events is cleared before a command runs and holds that command's KEYPAD_EVENT_ flags afterwards. A line
+ * that ends while a reply is still going out is held for uart_cmd_poll().
+ *
+ * @param: cmd Context.
+ * @param: c Received character.
+ *
+ * @return: 1 if a command ran and its reply is ready to send, 0 otherwise.
+ */
+int uart_cmd_receive(struct uart_cmd *cmd, char c);
+
+/**
+ * Next character to send.
+ *
+ * @param: cmd Context.
+ *
+ * @return: Character, or -1 once the reply, including every line of a stream, has been sent.
+ */
+int uart_cmd_transmit(struct uart_cmd *cmd);
+
+/**
+ * Run a line that was held while the previous reply went out, once that reply is done.
+ *
+ * keypad->events is updated as in uart_cmd_receive().
+ *
+ * @param: cmd Context.
+ *
+ * @return: 1 if a command ran and its reply is ready to send, 0 otherwise.
+ */
+int uart_cmd_poll(struct uart_cmd *cmd);
+
+#endif // UART_CMD_H
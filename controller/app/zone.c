@@ -0,0 +1,212 @@
+/**
+ * @file
+ * @brief Thermal zones: one plate sensor, one ambient reference and one heat/cool output pair each.
+ */
+
+#include "fixed.h"
+#include "lcd_frame.h"
+#include "ports.h"
+#include "lm19.h"
+#include "lm92.h"
+#include "zone.h"
+
+/** Reciprocal of each window size, 1 - WINDOW_MAX */
+static const uint32_t window_recip[WINDOW_MAX + 1] = {
+    0, FIXED_RECIP(1), FIXED_RECIP(2), FIXED_RECIP(3), FIXED_RECIP(4), FIXED_RECIP(5),
+    FIXED_RECIP(6), FIXED_RECIP(7), FIXED_RECIP(8), FIXED_RECIP(9), FIXED_RECIP(10),
+};
+
+/**
+ * Mean of a window of LM92 readings, multiplying by the window's reciprocal instead of dividing.
+ */
+static int sixteenths_mean(const int *samples, int window)
+{
+    int i;
+    int sum = 0;
+
+    for (i = 0; i < window; i++)
+    {
+        sum += samples[i]; // At most 10 * 2400 (150 C), so no overflow
+    }
+    return fixed_sdiv(sum, window, window_recip[window]);
+}
+
+/**
+ * Mean of a window of ADC counts. Ten 12-bit counts need all 16 bits, so the sum is unsigned.
+ */
+static unsigned int counts_mean(const int *samples, int window)
+{
+    int i;
+    unsigned int sum = 0;
+
+    for (i = 0; i < window; i++)
+    {
+        sum += (unsigned int)samples[i];
+    }
+    return fixed_udiv(sum, window, window_recip[window]);
+}
+
+int zone_push(struct zone *zone, int role, int raw, int window)
+{
+    struct zone_filter *filter = &zone->filters[role];
+
+    if (filter->index >= window)
+    {
+        filter->index = 0; // Window was shrunk since the last sample
+    }
+    filter->samples[filter->index++] = raw;
+    if (filter->index >= window)
+    {
+        filter->index = 0;
+        filter->collected = 1;
+    }
+    if (!filter->collected)
+    {
+        return 0;
+    }
+
+    if (zone->sources[role].type == SOURCE_LM92)
+    {
+        zone->tenths[role] = lm92_sixteenths_to_tenths(sixteenths_mean(filter->samples, window));
+    }
+    else
+    {
+        zone->tenths[role] = lm19_tenths(counts_mean(filter->samples, window));
+    }
+    stats_push(&zone->stats[role], zone->tenths[role]);
+    return 1;
+}
+
+void zone_reset_filters(struct zone *zone)
+{
+    int role;
+
+    for (role = ZONE_PLATE; role <= ZONE_AMBIENT; role++)
+    {
+        zone->filters[role].index = 0;
+        zone->filters[role].collected = 0;
+    }
+}
+
+unsigned int zone_begin(struct zone *zone, unsigned int time)
+{
+    zone->epoch.number++;
+    zone->epoch.start = time;
+    zone->epoch.present = 0;
+    return zone->epoch.number;
+}
+
+int zone_sample(struct zone *zone, unsigned int epoch, int role, int raw, unsigned int time)
+{
+    struct zone_epoch *current = &zone->epoch;
+
+    if (epoch != current->number || (current->present & (1 << role)))
+    {
+        return 0;
+    }
+    current->raw[role] = raw;
+    current->time[role] = time;
+    current->present |= 1 << role;
+    return current->present == ((1 << ZONE_PLATE) | (1 << ZONE_AMBIENT));
+}
+
+int zone_deliver(struct zone *zone, int window)
+{
+    int plate = zone_push(zone, ZONE_PLATE, zone->epoch.raw[ZONE_PLATE], window);
+    int ambient = zone_push(zone, ZONE_AMBIENT, zone->epoch.raw[ZONE_AMBIENT], window);
+
+    return plate && ambient;
+}
+
+void zone_actuated(struct zone *zone, unsigned int time)
+{
+    zone->latency = time - zone->epoch.start; // Modulo 2^16, so a wrap of the timer in between does not matter
+    if (zone->latency > zone->latency_max)
+    {
+        zone->latency_max = zone->latency;
+    }
+}
+
+void zone_control(struct zone *zone)
+{
+    enum peltier_drive wanted = peltier_decide(zone->mode, zone->tenths[ZONE_PLATE],
+                                               stats_slope(&zone->stats[ZONE_PLATE]), zone->tenths[ZONE_AMBIENT],
+                                               zone->setpoint_tenths, zone->drive);
+
+    if ((zone->alarms[ZONE_PLATE] | zone->alarms[ZONE_AMBIENT]) & LM92_STATUS_T_CRIT)
+    {
+        wanted = PELTIER_OFF;
+    }
+    zone->drive = energy_schedule(zone->budget, &zone->energy, zone->mode, wanted);
+
+    if (zone->drive == PELTIER_HEAT)
+    {
+        *zone->port &= ~zone->cool_pin;
+        *zone->port |= zone->heat_pin;
+    }
+    else if (zone->drive == PELTIER_COOL)
+    {
+        *zone->port &= ~zone->heat_pin;
+        *zone->port |= zone->cool_pin;
+    }
+    else
+    {
+        *zone->port &= ~(zone->heat_pin | zone->cool_pin);
+    }
+}
+
+void zone_stop(struct zone *zone)
+{
+    zone->drive = PELTIER_OFF;
+    *zone->port &= ~(zone->heat_pin | zone->cool_pin);
+    energy_release(zone->budget, &zone->energy);
+}
+
+int zone_target(const struct zone *zone)
+{
+    return (zone->mode == MATCH) ? zone->tenths[ZONE_AMBIENT] : zone->setpoint_tenths;
+}
+
+/**
+ * Put a temperature in the frame as integer and decimal parts, both truncated towards zero.
+ */
+static void frame_temperature(char *frame, int offset, int tenths)
+{
+    int whole = fixed_sdiv(tenths, 10, FIXED_RECIP(10));
+
+    frame[offset] = whole;                   // Integer part, two's complement
+    frame[offset + 1] = tenths - whole * 10; // Decimal part, same sign as the integer part
+}
+
+void zone_frame(const struct zone *zone, unsigned char page, unsigned char mode_code, unsigned char window,
+                char *frame)
+{
+    int target = zone_target(zone);
+    int slope = stats_slope(&zone->stats[ZONE_PLATE]);
+    unsigned int eta = stats_eta(&zone->stats[ZONE_PLATE], target);
+    long energy = energy_joules(zone->budget, zone->energy.mode_updates);
+
+    frame[LCD_FRAME_PAGE] = page;
+    frame[LCD_FRAME_MODE] = mode_code;
+    frame_temperature(frame, LCD_FRAME_AMBIENT, zone->tenths[ZONE_AMBIENT]);
+    frame_temperature(frame, LCD_FRAME_PLATE, zone->tenths[ZONE_PLATE]);
+    frame[LCD_FRAME_WINDOW] = window;
+    frame_temperature(frame, LCD_FRAME_TARGET, target);
+    frame[LCD_FRAME_SLOPE] = (slope > 127) ? 127 : (slope < -127) ? -127 : slope;
+    frame[LCD_FRAME_ETA] = eta >> 8;
+    frame[LCD_FRAME_ETA + 1] = eta & 0xFF;
+    energy = (energy > 0xFFFF) ? 0xFFFF : energy;
+    frame[LCD_FRAME_ENERGY] = energy >> 8;
+    frame[LCD_FRAME_ENERGY + 1] = energy & 0xFF;
+}
+
+unsigned char zone_next(unsigned char count)
+{
+    static unsigned char current = 0;
+
+    if (++current >= count)
+    {
+        current = 0;
+    }
+    return current;
+}
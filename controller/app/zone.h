@@ -0,0 +1,247 @@
+/**
+ * @file
+ * @brief Thermal zones: one plate sensor, one ambient reference and one heat/cool output pair each.
+ *
+ * Sensors are described by where their reading comes from, an ADC channel (LM19) or an LM92 address on UCB1, so any
+ * mix of the two can be used for either role. Raw readings are averaged per zone and only converted to tenths of a
+ * degree once the window has filled, as the single-zone code did.
+ *
+ * Zones are serviced round robin, one per scheduler tick, so acquisitions and control updates are spread evenly over
+ * the control period instead of all landing in the same tick.
+ *
+ * Each tick starts an acquisition epoch: both of the zone's sensors are read side by side, each reading is stamped with
+ * its epoch and arrival time, and only once both readings of the same epoch are in are they delivered together, so
+ * the plate and ambient values control compares always come from the same acquisition. Control runs as soon as the
+ * pair is complete rather than at the next tick, so the time from sampling to the outputs changing is the read time
+ * plus processing, not a control period; it is kept per zone.
+ */
+
+#ifndef ZONE_H
+#define ZONE_H
+
+#include "app_state.h"
+#include "energy.h"
+#include "keypad.h"
+#include "peltier.h"
+#include "stats.h"
+
+#define ZONE_MAX 4     // UCB1 can address four LM92s (A0/A1 straps)
+#define ZONE_PLATE 0   // Role of a sensor within a zone
+#define ZONE_AMBIENT 1
+
+/**
+ * Where a sensor reading comes from.
+ */
+enum zone_source_type {SOURCE_ADC, SOURCE_LM92};
+
+/**
+ * A sensor attached to a zone.
+ */
+struct zone_source
+{
+    /** Kind of sensor, an enum zone_source_type kept to a byte */
+    unsigned char type;
+
+    /** ADC input channel (ADCINCH_x value) or LM92 I2C address */
+    unsigned char id;
+};
+
+/**
+ * Boxcar window of raw readings.
+ */
+struct zone_filter
+{
+    /** ADC counts or LM92 1/16 degree C */
+    int samples[WINDOW_MAX];
+
+    /** Next slot to write */
+    unsigned char index;
+
+    /** Non-zero once the window has filled */
+    unsigned char collected;
+};
+
+/**
+ * One acquisition epoch of a zone: a reading from each sensor, started together.
+ */
+struct zone_epoch
+{
+    /** Epoch number, counting acquisitions of the zone */
+    unsigned int number;
+
+    /** Time the reads were started, ACLK counts */
+    unsigned int start;
+
+    /** Time each reading arrived, ACLK counts, indexed like sources */
+    unsigned int time[2];
+
+    /** Raw readings, indexed like sources */
+    int raw[2];
+
+    /** Bit (1 << role) set for each reading in */
+    unsigned char present;
+};
+
+/**
+ * One independently controlled thermal zone.
+ */
+struct zone
+{
+    /** Sensors, indexed by ZONE_PLATE and ZONE_AMBIENT */
+    struct zone_source sources[2];
+
+    /** Averaging state for each sensor */
+    struct zone_filter filters[2];
+
+    /** Latest averaged readings, tenths of a degree C, indexed like sources */
+    int tenths[2];
+
+    /** LM92_STATUS_ flags of the last reading from each sensor, indexed like sources; always 0 for an ADC sensor */
+    unsigned char alarms[2];
+
+    /** Running statistics of the averaged readings, indexed like sources */
+    struct stats stats[2];
+
+    /** Peltier mode */
+    enum State mode;
+
+    /** MATCH_SET target, tenths of a degree C */
+    int setpoint_tenths;
+
+    /** Drive currently applied */
+    enum peltier_drive drive;
+
+    /** Output port holding the heat and cool pins */
+    volatile unsigned char *port;
+
+    /** Heat output pin mask */
+    unsigned char heat_pin;
+
+    /** Cool output pin mask */
+    unsigned char cool_pin;
+
+    /** Power budget shared with the other zones */
+    struct energy_budget *budget;
+
+    /** Duty scheduling and energy used */
+    struct energy_meter energy;
+
+    /** Acquisition being collected */
+    struct zone_epoch epoch;
+
+    /** ACLK counts from the start of the last delivered epoch to its outputs being set */
+    unsigned int latency;
+
+    /** Largest latency seen */
+    unsigned int latency_max;
+};
+
+/**
+ * Add a raw reading and refresh the averaged temperature once the window is full.
+ *
+ * @param: zone Zone the reading belongs to.
+ * @param: role ZONE_PLATE or ZONE_AMBIENT.
+ * @param: raw ADC counts or LM92 1/16 degree C, depending on the source type.
+ * @param: window Samples to average, 1 - WINDOW_MAX.
+ *
+ * @return: 1 if the averaged temperature was updated, 0 while the window is still filling.
+ */
+int zone_push(struct zone *zone, int role, int raw, int window);
+
+/**
+ * Empty both averaging windows, so that after a window size change no average mixes in slots left from the old size.
+ * The averaged temperatures keep their last values until the windows have filled again.
+ *
+ * @param: zone Zone.
+ */
+void zone_reset_filters(struct zone *zone);
+
+/**
+ * Start a new acquisition epoch. A pair still incomplete from the previous epoch is dropped.
+ *
+ * @param: zone Zone being read.
+ * @param: time Current time, ACLK counts.
+ *
+ * @return: Number of the new epoch, to be passed back with each of its readings.
+ */
+unsigned int zone_begin(struct zone *zone, unsigned int time);
+
+/**
+ * Collect one raw reading of an epoch.
+ *
+ * @param: zone Zone the reading belongs to.
+ * @param: epoch Epoch the read was started in; readings of any other epoch are dropped.
+ * @param: role ZONE_PLATE or ZONE_AMBIENT.
+ * @param: raw ADC counts or LM92 1/16 degree C, depending on the source type.
+ * @param: time Arrival time, ACLK counts.
+ *
+ * @return: 1 if this completed the epoch's pair, 0 otherwise.
+ */
+int zone_sample(struct zone *zone, unsigned int epoch, int role, int raw, unsigned int time);
+
+/**
+ * Deliver the completed pair of the current epoch to the averaging windows, both roles together.
+ *
+ * @param: zone Zone.
+ * @param: window Samples to average, 1 - WINDOW_MAX.
+ *
+ * @return: 1 if the averaged temperatures were updated, 0 while the windows are still filling.
+ */
+int zone_deliver(struct zone *zone, int window);
+
+/**
+ * Record that the outputs were set from the current epoch.
+ *
+ * @param: zone Zone.
+ * @param: time Current time, ACLK counts.
+ */
+void zone_actuated(struct zone *zone, unsigned int time);
+
+/**
+ * Run the Peltier decision for a zone and drive its outputs, within the zone's power budget.
+ *
+ * The plate slope from the zone's statistics is used to act ahead of the plate's lag. While either of the zone's LM92s
+ * reports T_CRIT the outputs stay off, whatever the mode.
+ *
+ * @param: zone Zone to update.
+ */
+void zone_control(struct zone *zone);
+
+/**
+ * Turn a zone's outputs off.
+ *
+ * @param: zone Zone to stop.
+ */
+void zone_stop(struct zone *zone);
+
+/**
+ * Temperature the zone is being driven towards: ambient in MATCH, the setpoint otherwise.
+ *
+ * @param: zone Zone.
+ *
+ * @return: Target, tenths of a degree C.
+ */
+int zone_target(const struct zone *zone);
+
+/**
+ * Build the LCD frame for a zone's page, including the energy used since the zone's mode was selected.
+ *
+ * @param: zone Zone to show.
+ * @param: page Page number, the zone's index.
+ * @param: mode_code Keypad mode code to show.
+ * @param: window Boxcar window to show.
+ * @param: frame Buffer of LCD_FRAME_BYTES to fill.
+ */
+void zone_frame(const struct zone *zone, unsigned char page, unsigned char mode_code, unsigned char window,
+                char *frame);
+
+/**
+ * Pick the zone to service on this scheduler tick.
+ *
+ * @param: count Number of configured zones.
+ *
+ * @return: Zone index, cycling through 0 .. count - 1.
+ */
+unsigned char zone_next(unsigned char count);
+
+#endif // ZONE_H
@@ -0,0 +1,78 @@
+/**
+ * @file
+ * @brief HD44780 driver, 4-bit interface on port 1.
+ */
+
+#include <msp430.h>
+#include "lcd.h"
+
+void lcd_pulse_enable(){
+    // Pulses the enable pin so LCD knows to take next nibble.
+    PXOUT |= E;         // Enable Enable pin
+    PXOUT &= ~E;        // Disable Enable pin
+}
+
+void lcd_send_nibble(char nibble){
+    // Sends out four bits to the LCD by setting the last four pins (D4 - 7) to the nibble.
+
+    PXOUT &= ~(D4 | D5 | D6 | D7); // Clear the out bits associated with our data lines.
+
+    // For each bit of the nibble, set the associated data line to it.
+    if (nibble & BIT0) PXOUT |= D4;
+    if (nibble & BIT1) PXOUT |= D5;
+    if (nibble & BIT2) PXOUT |= D6;
+    if (nibble & BIT3) PXOUT |= D7;
+
+    //PXOUT = (PXOUT &= 0xF0) | (nibble & 0x0F); // First we clear the first four bits, then we set them to the nibble.
+    lcd_pulse_enable();  // Pulse enable so LCD reads our input
+}
+
+void lcd_send_command(char command){
+    // Takes an 8-bit command and sends out the two nibbles sequentially.
+    PXOUT &= ~RS; // CLEAR RS to set to command mode
+    lcd_send_nibble(command >> 4); // Send upper nibble by bit shifting it to lower nibble
+    lcd_send_nibble(command & 0x0F); // Send lower nibble by clearing upper nibble.
+}
+
+void lcd_send_data(char data){
+    // Takes an 8-bit data and sends out the two nibbles sequentially.
+    PXOUT |= RS; // SET RS to set to data mode
+    lcd_send_nibble(data >> 4); // Send upper nibble by bit shifting it to lower nibble
+    lcd_send_nibble(data & 0x0F); // Send lower nibble by clearing upper nibble.
+}
+
+void lcd_print_sentence(char *str){
+    // Takes a string and iterates character by character, sending that character to be written out, until \0 is reached.
+    while(*str){
+        lcd_send_data(*str);
+        str++;
+    }
+}
+
+void lcd_clear(){
+    // Clearing the screen is temperamental and requires a good delay, this is pretty arbitrary with a good safety margin.
+    lcd_send_command(0x01);   // Clear display
+    __delay_cycles(2000);   // Clear display needs some time, I'm aware __delay_cycles generally isn't advised, but it works in this context
+}
+
+void lcdInit(){
+    // Initializes the LCD to 4 bit mode, 2 lines 5x8 font, with enabled display and cursor,
+    // clear the display, then set cursor to proper location.
+
+    PXOUT &= ~RS; // Explicitly set RS to 0 so we are in command mode
+
+    // We need to send the code 3h, 3 times, to properly wake up the LCD screen
+    lcd_send_nibble(0x03);
+    lcd_send_nibble(0x03);
+    lcd_send_nibble(0x03);
+
+    lcd_send_nibble(0x02);    // Code 2h sets it to 4-bit mode after waking up
+
+    lcd_send_command(0x28);   // Code 28h sets it to 2 line, 5x8 font.
+
+    lcd_send_command(0x0C);   // Turns display on, turns cursor off, turns blink off.
+
+    lcd_send_command(0x06);   // Increments cursor on each input
+
+    lcd_clear();             // Clear display
+}
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief HD44780 driver, 4-bit interface on port 1.
+ */
+
+#ifndef LCD_H
+#define LCD_H
+
+// Port definitions
+#define PXOUT P1OUT
+#define PXSEL0 P1SEL0
+#define PXSEL1 P1SEL1
+#define PXDIR P1DIR
+
+// Pin definitions
+#define D4 BIT0
+#define D5 BIT1
+#define D6 BIT4
+#define D7 BIT5
+
+#define E BIT6
+#define RS BIT7
+
+#define LCD_SET_CGRAM 0x40 // Set CGRAM address command, OR in glyph * 8 + row
+#define LCD_SET_DDRAM 0x80 // Set DDRAM address command, OR in the cell address
+#define LCD_LINE_2 0x40    // DDRAM address of the first cell on line 2
+
+/** Pulse the enable pin so the LCD latches the data lines. */
+void lcd_pulse_enable();
+
+/** Put the low four bits of nibble on D4 - D7 and latch them. */
+void lcd_send_nibble(char nibble);
+
+/** Send an 8-bit instruction as two nibbles. */
+void lcd_send_command(char command);
+
+/** Write one byte to DDRAM or CGRAM, whichever was addressed last. */
+void lcd_send_data(char data);
+
+/** Write a null-terminated string from the current cursor position. */
+void lcd_print_sentence(char *str);
+
+/** Clear the display and wait for it to finish. */
+void lcd_clear();
+
+/** Wake the LCD into 4-bit, two line mode with the cursor off, and clear it. */
+void lcdInit();
+
+#endif // LCD_H
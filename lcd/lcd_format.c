@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @brief Text formatting for the LCD status screen.
+ */
+
+#include "fixed.h"
+#include "lcd_format.h"
+
+void lcd_format_temperature(char *out, int tenths)
+{
+    char digits[3];
+    int i = 0;
+
+    if (tenths < 0)
+    {
+        out[i++] = '-';
+        fixed_format(digits, (uint16_t)fixed_clamp(-(long)tenths, 0, 999), 3);
+        if (tenths <= -100)
+        {
+            out[i++] = digits[0];  // Tens place
+            out[i++] = digits[1];  // Ones place
+            out[i++] = ' ';        // No room for the tenths
+        }
+        else
+        {
+            out[i++] = digits[1];
+            out[i++] = '.';
+            out[i++] = digits[2];  // Tenths place
+        }
+    }
+    else
+    {
+        fixed_format(digits, (uint16_t)fixed_clamp(tenths, 0, 999), 3);
+        out[i++] = digits[0];  // Tens place
+        out[i++] = digits[1];  // Ones place
+        out[i++] = '.';
+        out[i++] = digits[2];  // Tenths place
+    }
+    out[i++] = (char)0xDF; // Degrees symbol
+    out[i++] = 'C';
+    out[i] = '\0';
+}
+
+void lcd_format_op_time(char *out, int op_time)
+{
+    fixed_format(out, (uint16_t)fixed_clamp(op_time, 0, 999), 3);
+    out[3] = 's';
+    out[4] = '\0';
+}
+
+void lcd_format_eta(char *out, unsigned int seconds)
+{
+    if (seconds > 99 * 60)
+    {
+        out[0] = ' ';
+        out[1] = '-';
+        out[2] = '-';
+        out[3] = ' ';
+    }
+    else
+    {
+        out[0] = '~';
+        if (seconds >= 100)
+        {
+            // Round up, it is an estimate of when the plate gets there
+            fixed_format(&out[1], fixed_udiv(seconds + 59, 60, FIXED_RECIP(60)), 2);
+            out[3] = 'm';
+        }
+        else
+        {
+            fixed_format(&out[1], seconds, 2);
+            out[3] = 's';
+        }
+    }
+    out[4] = '\0';
+}
+
+void lcd_format_energy(char *out, unsigned int joules)
+{
+    if (joules < 1000)
+    {
+        fixed_format(out, joules, 3);
+        out[3] = 'J';
+    }
+    else if (joules < 10000)
+    {
+        fixed_format(out, fixed_udiv(joules, 100, FIXED_RECIP(100)), 2); // Tenths of a kJ
+        out[2] = out[1];
+        out[1] = '.';
+        out[3] = 'k';
+    }
+    else
+    {
+        fixed_format(out, fixed_udiv(joules, 1000, FIXED_RECIP(1000)), 2);
+        out[2] = 'k';
+        out[3] = 'J';
+    }
+    out[4] = '\0';
+}
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief Text formatting for the LCD status screen.
+ */
+
+#ifndef LCD_FORMAT_H
+#define LCD_FORMAT_H
+
+#define LCD_TEMPERATURE_LENGTH 7 // "DD.D", degrees symbol, 'C' and terminator
+#define LCD_OP_TIME_LENGTH 5     // "DDDs" and terminator
+#define LCD_ETA_LENGTH 5         // "~DDs" or "~DDm" and terminator
+#define LCD_ENERGY_LENGTH 5      // "DDDJ", "D.Dk" or "DDkJ" and terminator
+
+/**
+ * Format a temperature as "DD.D" followed by the degrees symbol and 'C'.
+ *
+ * Negative temperatures keep the same width: "-D.D" down to -9.9, then "-DD " without the fraction. Values beyond
+ * +/-99.9 are shown as the limit.
+ *
+ * @param: out Buffer of at least LCD_TEMPERATURE_LENGTH characters.
+ * @param: tenths Temperature, tenths of a degree C.
+ */
+void lcd_format_temperature(char *out, int tenths);
+
+/**
+ * Format the operating time as "DDDs".
+ *
+ * @param: out Buffer of at least LCD_OP_TIME_LENGTH characters.
+ * @param: op_time Seconds in the current mode, 0 - 999.
+ */
+void lcd_format_op_time(char *out, int op_time);
+
+/**
+ * Format a time-to-target as "~DDs" below 100 s, "~DDm" up to 99 minutes, and " -- " when unknown or longer.
+ *
+ * @param: out Buffer of at least LCD_ETA_LENGTH characters.
+ * @param: seconds Seconds to target, LCD_ETA_UNKNOWN if not approaching.
+ */
+void lcd_format_eta(char *out, unsigned int seconds);
+
+/**
+ * Format energy as "DDDJ" below 1000 J, "D.Dk" (kJ, truncated) below 10 kJ and "DDkJ" above.
+ *
+ * @param: out Buffer of at least LCD_ENERGY_LENGTH characters.
+ * @param: joules Energy, joules.
+ */
+void lcd_format_energy(char *out, unsigned int joules);
+
+#endif // LCD_FORMAT_H
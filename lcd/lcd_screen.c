@@ -0,0 +1,236 @@
+/**
+ * @file
+ * @brief Incremental screen composition with custom CGRAM graphics.
+ */
+
+#include "lcd.h"
+#include "lcd_screen.h"
+
+#define SHADOW_UNKNOWN 0x00 // Never composed, so the first flush always writes the cell
+
+static char text[LCD_ROWS][LCD_COLUMNS];
+static char shown_text[LCD_ROWS][LCD_COLUMNS];
+static unsigned char glyphs[LCD_GLYPHS][LCD_GLYPH_ROWS];
+static unsigned char shown_glyphs[LCD_GLYPHS][LCD_GLYPH_ROWS];
+static unsigned char glyph_valid; // Bit n set once glyph n has been uploaded
+
+static int history[LCD_HISTORY_LENGTH];
+static unsigned char history_head;  // Next slot to write, also the oldest sample once full
+static unsigned char history_count;
+
+void lcd_screen_begin(void)
+{
+    int row, column;
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            text[row][column] = ' ';
+        }
+    }
+}
+
+void lcd_screen_put(int row, int column, const char *str)
+{
+    while (*str && column < LCD_COLUMNS)
+    {
+        text[row][column++] = *str++;
+    }
+}
+
+void lcd_screen_history_push(int tenths)
+{
+    history[history_head] = tenths;
+    if (++history_head >= LCD_HISTORY_LENGTH)
+    {
+        history_head = 0;
+    }
+    if (history_count < LCD_HISTORY_LENGTH)
+    {
+        history_count++;
+    }
+}
+
+void lcd_screen_sparkline(int first_glyph, int cells)
+{
+    int min = 0, max = 0, span;
+    int i, sample, row, index, cell;
+    int start = (history_count < LCD_HISTORY_LENGTH) ? 0 : history_head;
+    int x = cells * LCD_GLYPH_WIDTH - history_count; // Right-align so the newest sample is always in the last column
+    unsigned char bit;
+    long scaled;
+
+    for (i = 0; i < cells; i++)
+    {
+        for (row = 0; row < LCD_GLYPH_ROWS; row++)
+        {
+            glyphs[first_glyph + i][row] = 0;
+        }
+    }
+    if (history_count == 0)
+    {
+        return;
+    }
+
+    index = start;
+    for (i = 0; i < history_count; i++)
+    {
+        sample = history[index];
+        if (i == 0 || sample < min)
+        {
+            min = sample;
+        }
+        if (i == 0 || sample > max)
+        {
+            max = sample;
+        }
+        if (++index == LCD_HISTORY_LENGTH)
+        {
+            index = 0;
+        }
+    }
+    span = (max - min < 10) ? 10 : max - min;
+
+    // Skip samples that do not fit, then walk the columns with a cell counter and a bit mask instead of x / and x %
+    index = start;
+    while (x < 0)
+    {
+        if (++index == LCD_HISTORY_LENGTH)
+        {
+            index = 0;
+        }
+        x++;
+    }
+    cell = first_glyph;
+    bit = 0x10;
+    while (x >= LCD_GLYPH_WIDTH)
+    {
+        x -= LCD_GLYPH_WIDTH;
+        cell++;
+    }
+    bit >>= x;
+
+    for (; cell < first_glyph + cells; index = (index + 1 == LCD_HISTORY_LENGTH) ? 0 : index + 1)
+    {
+        // Height above the bottom row in sevenths of the span, by repeated subtraction (at most 7 times)
+        scaled = (long)(history[index] - min) * (LCD_GLYPH_ROWS - 1);
+        row = LCD_GLYPH_ROWS - 1;
+        while (scaled >= span)
+        {
+            scaled -= span;
+            row--;
+        }
+        glyphs[cell][row] |= bit;
+        bit >>= 1;
+        if (bit == 0)
+        {
+            bit = 0x10;
+            cell++;
+        }
+    }
+}
+
+void lcd_screen_error_bar(int first_glyph, int error_tenths, int tenths_per_pixel)
+{
+    unsigned char left = 0, right = 0;
+    int pixels = 0;
+    int magnitude = (error_tenths < 0) ? -error_tenths : error_tenths;
+    int row;
+
+    // Whole pixels by repeated subtraction, stopping at the bar's width
+    while (magnitude >= tenths_per_pixel && pixels < LCD_GLYPH_WIDTH)
+    {
+        magnitude -= tenths_per_pixel;
+        pixels++;
+    }
+    if (error_tenths < 0)
+    {
+        pixels = -pixels;
+    }
+
+    if (pixels < 0)
+    {
+        left = (1 << -pixels) - 1; // Fill from the right edge of the left cell
+    }
+    else if (pixels > 0)
+    {
+        right = (0x1F << (LCD_GLYPH_WIDTH - pixels)) & 0x1F; // Fill from the left edge of the right cell
+    }
+
+    for (row = 0; row < LCD_GLYPH_ROWS; row++)
+    {
+        // Bar in rows 2 - 5, with a one-pixel centre mark down the full height
+        int in_bar = row >= 2 && row <= 5;
+        glyphs[first_glyph][row] = (in_bar ? left : 0) | 0x01;
+        glyphs[first_glyph + 1][row] = (in_bar ? right : 0) | 0x10;
+    }
+}
+
+int lcd_screen_flush(void)
+{
+    int writes = 0;
+    int row, column, glyph;
+    int addressed;
+
+    // Glyphs first, so text that refers to them shows the new shape straight away
+    for (glyph = 0; glyph < LCD_GLYPHS; glyph++)
+    {
+        addressed = 0;
+        for (row = 0; row < LCD_GLYPH_ROWS; row++)
+        {
+            if ((glyph_valid & (1 << glyph)) && shown_glyphs[glyph][row] == glyphs[glyph][row])
+            {
+                addressed = 0;
+                continue;
+            }
+            if (!addressed)
+            {
+                lcd_send_command(LCD_SET_CGRAM | (glyph * LCD_GLYPH_ROWS + row));
+                writes++;
+                addressed = 1;
+            }
+            lcd_send_data(glyphs[glyph][row]);
+            shown_glyphs[glyph][row] = glyphs[glyph][row];
+            writes++;
+        }
+        glyph_valid |= 1 << glyph;
+    }
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        addressed = 0;
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            if (shown_text[row][column] == text[row][column])
+            {
+                addressed = 0; // The cursor has to be moved past unchanged cells
+                continue;
+            }
+            if (!addressed)
+            {
+                lcd_send_command(LCD_SET_DDRAM | (row * LCD_LINE_2 + column));
+                writes++;
+                addressed = 1;
+            }
+            lcd_send_data(text[row][column]);
+            shown_text[row][column] = text[row][column];
+            writes++;
+        }
+    }
+    return writes;
+}
+
+void lcd_screen_invalidate(void)
+{
+    int row, column;
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            shown_text[row][column] = SHADOW_UNKNOWN;
+        }
+    }
+    glyph_valid = 0;
+}
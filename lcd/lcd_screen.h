@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Incremental screen composition with custom CGRAM graphics.
+ *
+ * Each refresh composes the whole 16x2 screen and the custom glyphs into a back buffer, then lcd_screen_flush() sends
+ * only the cells and glyph rows that differ from what is already on the LCD. The display is never cleared, so a
+ * refresh costs at most LCD_SCREEN_MAX_WRITES bus writes and usually far fewer.
+ *
+ * Glyphs are referenced in text as LCD_GLYPH(n): HD44780 codes 8 - 15 mirror CGRAM 0 - 7 and, unlike 0 - 7, do not
+ * end a C string.
+ */
+
+#ifndef LCD_SCREEN_H
+#define LCD_SCREEN_H
+
+#define LCD_COLUMNS 16
+#define LCD_ROWS 2
+#define LCD_GLYPHS 8
+#define LCD_GLYPH_ROWS 8
+#define LCD_GLYPH_WIDTH 5
+#define LCD_GLYPH(n) ((char)(8 + (n)))
+
+#define LCD_HISTORY_LENGTH 15 // One pixel column per sample across three sparkline cells
+
+// A run of changed cells costs one address command plus its data, so a line or glyph never needs more than one write
+// per cell plus one
+#define LCD_SCREEN_MAX_WRITES (LCD_ROWS * (LCD_COLUMNS + 1) + LCD_GLYPHS * (LCD_GLYPH_ROWS + 1))
+
+/**
+ * Start composing a new frame: blank text, glyphs kept from the previous frame.
+ */
+void lcd_screen_begin(void);
+
+/**
+ * Place text in the back buffer, clipped at the end of the line.
+ *
+ * @param: row 0 or 1.
+ * @param: column 0 - 15.
+ * @param: text Null-terminated string; LCD_GLYPH(n) places a custom glyph.
+ */
+void lcd_screen_put(int row, int column, const char *text);
+
+/**
+ * Add a sample to the trend history.
+ *
+ * @param: tenths Temperature, tenths of a degree C.
+ */
+void lcd_screen_history_push(int tenths);
+
+/**
+ * Draw the trend history as a sparkline across consecutive glyphs, oldest on the left, auto-scaled to the history's
+ * range (at least 1 C).
+ *
+ * @param: first_glyph CGRAM glyph for the leftmost cell.
+ * @param: cells Number of cells; each shows LCD_GLYPH_WIDTH samples.
+ */
+void lcd_screen_sparkline(int first_glyph, int cells);
+
+/**
+ * Draw a centre-zero bar across two glyphs: the left cell fills leftwards while error is negative, the right cell
+ * fills rightwards while it is positive.
+ *
+ * @param: first_glyph CGRAM glyph for the left cell; the right cell uses the next glyph.
+ * @param: error_tenths Error, tenths of a degree C.
+ * @param: tenths_per_pixel Scale of one bar column.
+ */
+void lcd_screen_error_bar(int first_glyph, int error_tenths, int tenths_per_pixel);
+
+/**
+ * Send whatever changed since the last flush to the LCD.
+ *
+ * @return: Number of bus writes (commands plus data), at most LCD_SCREEN_MAX_WRITES.
+ */
+int lcd_screen_flush(void);
+
+/**
+ * Forget what is on the LCD so the next flush redraws everything; use after clearing or initialising it.
+ */
+void lcd_screen_invalidate(void);
+
+#endif // LCD_SCREEN_H
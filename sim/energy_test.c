@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Host checks of the drive sequences energy_schedule() produces.
+ *
+ * Each check feeds a zone a string of wanted drives, one per control update, and compares what energy_schedule()
+ * lets it drive with the intended pattern: 'H' heat, 'C' cool, '-' off. The patterns are written out by hand from the
+ * rules in controller/app/energy.h, so a change to the scheduler that alters any of them shows up here.
+ *
+ * Each failure is printed with both sequences; the exit status is 1 if there were any.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "energy.h"
+
+#define UPDATES_MAX 32
+
+static int failures;
+
+static enum peltier_drive drive_of(char c)
+{
+    return (c == 'H') ? PELTIER_HEAT : (c == 'C') ? PELTIER_COOL : PELTIER_OFF;
+}
+
+static char char_of(enum peltier_drive drive)
+{
+    return (drive == PELTIER_HEAT) ? 'H' : (drive == PELTIER_COOL) ? 'C' : '-';
+}
+
+/**
+ * Schedule one zone through a sequence of wanted drives and compare the result with the intended pattern.
+ */
+static void check(const char *name, struct energy_budget *budget, struct energy_meter *meter, const char *wanted,
+                  const char *expected)
+{
+    char actual[UPDATES_MAX + 1];
+    size_t i;
+
+    for (i = 0; wanted[i] != '\0' && i < UPDATES_MAX; i++)
+    {
+        actual[i] = char_of(energy_schedule(budget, meter, MATCH_SET, drive_of(wanted[i])));
+    }
+    actual[i] = '\0';
+    if (strcmp(actual, expected) != 0)
+    {
+        printf("FAIL %s\n  wanted:   %s\n  expected: %s\n  actual:   %s\n", name, wanted, expected, actual);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    struct energy_budget budget;
+    struct energy_meter meter;
+    struct energy_meter other;
+
+    // Heating to cooling: held off for ENERGY_REVERSE_UPDATES, then full drive at once
+    energy_init(&budget, Q16_16(18), 1, 0, 0);
+    memset(&meter, 0, sizeof(meter));
+    check("heat to cool", &budget, &meter, "HHHCCCCCCC", "HHH----CCC");
+
+    // And back; the hold starts over from the last direction driven
+    check("cool to heat", &budget, &meter, "HHHHHH", "----HH");
+
+    // Starting from off is not a reversal, nor is resuming the same direction after off
+    memset(&meter, 0, sizeof(meter));
+    check("from off", &budget, &meter, "-H--HH", "-H--HH");
+
+    // A reversal that is withdrawn within the hold still holds the next drive either way, until the zone has been off
+    // for ENERGY_REVERSE_UPDATES in a row
+    memset(&meter, 0, sizeof(meter));
+    check("withdrawn reversal", &budget, &meter, "HC--HHHHH", "H----HHHH");
+
+    // Off for the length of a hold before the other direction: no hold left to serve
+    memset(&meter, 0, sizeof(meter));
+    check("rested reversal", &budget, &meter, "HH----CC", "HH----CC");
+    check("long rest", &budget, &meter, "--------------------HH", "--------------------HH");
+
+    // A shorter rest counts towards the hold
+    memset(&meter, 0, sizeof(meter));
+    check("short rest", &budget, &meter, "HH--CCCC", "HH----CC");
+
+    // Half the rated power: the ENERGY_BURST_UPDATES of saved credit, topped up by half an update each update, cover
+    // seven updates; after that drive alternates
+    energy_init(&budget, Q16_16(18), 1, ENERGY_RATED_W / 2, 0);
+    memset(&meter, 0, sizeof(meter));
+    check("half power", &budget, &meter, "HHHHHHHHHHHH", "HHHHHHH-H-H-");
+
+    // Peak current for one Peltier: a second zone waits until the first stops
+    energy_init(&budget, Q16_16(18), 2, 0, ENERGY_RATED_MA);
+    memset(&meter, 0, sizeof(meter));
+    memset(&other, 0, sizeof(other));
+    check("first zone", &budget, &meter, "H", "H");
+    check("second zone, first driving", &budget, &other, "C", "-");
+    check("first zone stops", &budget, &meter, "-", "-");
+    check("second zone, first off", &budget, &other, "C", "C");
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file
+ * @brief Fault injection against the controller's supervisor, measuring time to Peltier-off.
+ *
+ * The controller's timers are simulated in ACLK counts: the supervisor tick, the control tick that starts each zone's
+ * sensor reads, the reads and display frame that follow it, the 1 ms keypad scan and the 1 s hardware watchdog. The
+ * unmodified supervisor from controller/app decides when deadlines are missed, the Peltier goes off on a miss as in
+ * recover(), and the board resets when the watchdog is not fed in time.
+ *
+ * Each fault is injected at a random phase of every timer and the time from the fault to the Peltier going off, and to
+ * the watchdog reset, is reported with the worst case over all trials.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "supervisor.h"
+
+#define TRIALS 10000
+#define ACLK_HZ 32768.0
+#define SUPERVISOR_PERIOD 4096 // As in main.c
+#define CONTROL_PERIOD 16384   // One zone
+#define WATCHDOG_PERIOD 32768  // WDTIS__32K
+#define KEYPAD_PERIOD 33       // 1 ms scan, to the nearest ACLK count
+#define READ_COUNTS 12         // LM92 read at 100 kHz, from the control tick
+#define FRAME_COUNTS 45        // Display frame at 100 kHz, 1.37 ms
+#define SETTLE_COUNTS 65536    // Run before the fault, 2 s
+#define RUN_COUNTS 524288      // Longest run, 16 s
+#define NEVER 0xFFFFFFFFUL
+
+/** Deadlines as in main.c */
+static const struct supervisor_deadline deadlines[SUPERVISOR_TASKS] = {
+    [SUPERVISOR_ACQUISITION] = {2, 0},
+    [SUPERVISOR_CONTROL] = {CONTROL_PERIOD / SUPERVISOR_PERIOD + 2, 1},
+    [SUPERVISOR_DISPLAY] = {2, 0},
+    [SUPERVISOR_KEYPAD] = {2, 1},
+};
+
+/**
+ * Injected faults.
+ */
+enum fault {FAULT_SENSOR, FAULT_CONTROL, FAULT_DISPLAY, FAULT_KEYPAD, FAULT_CPU, FAULTS};
+
+static const char *fault_names[FAULTS] = {
+    [FAULT_SENSOR] = "LM92 read never completes",
+    [FAULT_CONTROL] = "control tick stops",
+    [FAULT_DISPLAY] = "display bus held",
+    [FAULT_KEYPAD] = "keypad scan stops",
+    [FAULT_CPU] = "CPU stuck in an ISR",
+};
+
+/**
+ * Outcome of one trial, ACLK counts from the fault.
+ */
+struct outcome
+{
+    unsigned long off;
+    unsigned long reset;
+};
+
+static unsigned long earliest(const unsigned long *times, int count)
+{
+    unsigned long first = NEVER;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        first = (times[i] < first) ? times[i] : first;
+    }
+    return first;
+}
+
+/**
+ * Run one trial with the given timer phases and fault time.
+ */
+static struct outcome trial(enum fault fault, unsigned long control_phase, unsigned long keypad_phase,
+                            unsigned long fault_at)
+{
+    enum {SUPERVISOR_TICK, CONTROL_TICK, READ_DONE, FRAME_DONE, KEYPAD_SCAN, EVENTS};
+    unsigned long times[EVENTS];
+    struct outcome outcome = {NEVER, NEVER};
+    struct supervisor supervisor;
+    unsigned long fed = 0;
+    unsigned long now = 0;
+    int peltier_on = 1;
+
+    supervisor_init(&supervisor, deadlines);
+    times[SUPERVISOR_TICK] = SUPERVISOR_PERIOD;
+    times[CONTROL_TICK] = control_phase;
+    times[READ_DONE] = NEVER;
+    times[FRAME_DONE] = NEVER;
+    times[KEYPAD_SCAN] = keypad_phase;
+
+    while (now < RUN_COUNTS)
+    {
+        int faulted;
+
+        now = earliest(times, EVENTS);
+        if (now >= fed + WATCHDOG_PERIOD)
+        {
+            now = fed + WATCHDOG_PERIOD; // Watchdog reset, the outputs go off with it
+            break;
+        }
+        faulted = now >= fault_at;
+        if (faulted && fault == FAULT_CPU)
+        {
+            now = fed + WATCHDOG_PERIOD; // Nothing runs from here on, not even the supervisor
+            break;
+        }
+
+        if (now == times[SUPERVISOR_TICK])
+        {
+            unsigned char missed = supervisor_tick(&supervisor);
+
+            if (missed & ~(1 << SUPERVISOR_DISPLAY) && peltier_on)
+            {
+                peltier_on = 0;
+                outcome.off = now - fault_at;
+            }
+            if (supervisor_healthy(&supervisor))
+            {
+                fed = now;
+            }
+            times[SUPERVISOR_TICK] += SUPERVISOR_PERIOD;
+        }
+        else if (now == times[CONTROL_TICK])
+        {
+            times[CONTROL_TICK] += CONTROL_PERIOD;
+            if (faulted && fault == FAULT_CONTROL)
+            {
+                times[CONTROL_TICK] = NEVER;
+                continue;
+            }
+            supervisor_alive(&supervisor, SUPERVISOR_CONTROL);
+            supervisor_start(&supervisor, SUPERVISOR_ACQUISITION);
+            times[READ_DONE] = (faulted && fault == FAULT_SENSOR) ? NEVER : now + READ_COUNTS;
+        }
+        else if (now == times[READ_DONE])
+        {
+            times[READ_DONE] = NEVER;
+            supervisor_done(&supervisor, SUPERVISOR_ACQUISITION);
+            supervisor_start(&supervisor, SUPERVISOR_DISPLAY);
+            times[FRAME_DONE] = (faulted && fault == FAULT_DISPLAY) ? NEVER : now + FRAME_COUNTS;
+        }
+        else if (now == times[FRAME_DONE])
+        {
+            times[FRAME_DONE] = NEVER;
+            supervisor_done(&supervisor, SUPERVISOR_DISPLAY);
+        }
+        else
+        {
+            times[KEYPAD_SCAN] = (faulted && fault == FAULT_KEYPAD) ? NEVER : now + KEYPAD_PERIOD;
+            if (times[KEYPAD_SCAN] != NEVER)
+            {
+                supervisor_alive(&supervisor, SUPERVISOR_KEYPAD);
+            }
+        }
+    }
+
+    if (now < RUN_COUNTS)
+    {
+        outcome.reset = now - fault_at;
+        if (peltier_on)
+        {
+            outcome.off = outcome.reset;
+        }
+    }
+    return outcome;
+}
+
+static void report(unsigned long worst, double total, int count)
+{
+    if (count == 0)
+    {
+        printf(" %9s %9s", "never", "never");
+        return;
+    }
+    printf(" %9.0f %9.0f", total / count / ACLK_HZ * 1000, worst / ACLK_HZ * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed = (argc > 1) ? (unsigned int)atoi(argv[1]) : 1;
+    int fault;
+
+    srand(seed);
+    printf("%-28s %9s %9s %9s %9s\n", "fault", "off_ms", "worst", "reset_ms", "worst");
+    for (fault = 0; fault < FAULTS; fault++)
+    {
+        unsigned long worst_off = 0;
+        unsigned long worst_reset = 0;
+        double total_off = 0;
+        double total_reset = 0;
+        int offs = 0;
+        int resets = 0;
+        int i;
+
+        for (i = 0; i < TRIALS; i++)
+        {
+            unsigned long control_phase = rand() % CONTROL_PERIOD;
+            unsigned long keypad_phase = rand() % KEYPAD_PERIOD;
+            unsigned long fault_at = SETTLE_COUNTS + rand() % CONTROL_PERIOD;
+            struct outcome outcome = trial(fault, control_phase, keypad_phase, fault_at);
+
+            if (outcome.off != NEVER)
+            {
+                worst_off = (outcome.off > worst_off) ? outcome.off : worst_off;
+                total_off += outcome.off;
+                offs++;
+            }
+            if (outcome.reset != NEVER)
+            {
+                worst_reset = (outcome.reset > worst_reset) ? outcome.reset : worst_reset;
+                total_reset += outcome.reset;
+                resets++;
+            }
+        }
+        printf("%-28s", fault_names[fault]);
+        report(worst_off, total_off, offs);
+        report(worst_reset, total_reset, resets);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+/**
+ * @file
+ * @brief Host checks of the fixed-point library in common/fixed.h.
+ *
+ * Every operation is compared with a reference computed in wider integer arithmetic: the edges of each type, where
+ * saturation and rounding change, and a large number of random operands. Division by reciprocal is checked for every
+ * dividend against every divisor up to 1000 and against random divisors beyond, and formatting for every 16-bit value
+ * and, in 32 bits, for each change in the number of digits and random values.
+ *
+ * Each failure is printed with its operands; the exit status is 1 if there were any.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fixed.h"
+
+#define RANDOM_TRIALS 2000000L
+#define FAILURES_SHOWN 10
+
+static long failures;
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint32_t random32(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+/**
+ * Random operand biased towards the interesting values: small magnitudes, the limits and everything in between.
+ */
+static int32_t random_operand(void)
+{
+    switch (random32() & 3)
+    {
+    case 0:
+        return (int32_t)(random32() & 0x3FFFF) - 0x20000;
+    case 1:
+        return (random32() & 1) ? INT32_MAX - (int32_t)(random32() & 0xFF) : INT32_MIN + (int32_t)(random32() & 0xFF);
+    default:
+        return (int32_t)random32();
+    }
+}
+
+static void check(int ok, const char *what, int64_t a, int64_t b, int64_t expected, int64_t actual)
+{
+    if (!ok)
+    {
+        if (failures < FAILURES_SHOWN)
+        {
+            printf("FAIL %s(%" PRId64 ", %" PRId64 "): expected %" PRId64 ", got %" PRId64 "\n", what, a, b, expected,
+                   actual);
+        }
+        failures++;
+    }
+}
+
+static int64_t saturate(int64_t value, int64_t low, int64_t high)
+{
+    return (value < low) ? low : (value > high) ? high : value;
+}
+
+/** Arithmetic right shift of a 64-bit value, which C leaves to the implementation for negative values. */
+static int64_t floor_shift(int64_t value, int bits)
+{
+    return (value >= 0) ? value >> bits : -((-value + ((int64_t)1 << bits) - 1) >> bits);
+}
+
+static void check_q16_16(int32_t a, int32_t b)
+{
+    int64_t sum = saturate((int64_t)a + b, INT32_MIN, INT32_MAX);
+    int64_t difference = saturate((int64_t)a - b, INT32_MIN, INT32_MAX);
+    int64_t product = saturate(floor_shift((int64_t)a * b + Q16_16_ONE / 2, 16), INT32_MIN, INT32_MAX);
+
+    check(q16_16_add(a, b) == sum, "q16_16_add", a, b, sum, q16_16_add(a, b));
+    check(q16_16_sub(a, b) == difference, "q16_16_sub", a, b, difference, q16_16_sub(a, b));
+    check(q16_16_mul(a, b) == product, "q16_16_mul", a, b, product, q16_16_mul(a, b));
+    check(q16_16_scale(a, b) == product, "q16_16_scale", a, b, product, q16_16_scale(a, b));
+}
+
+static void test_q16_16(void)
+{
+    static const int32_t edges[] = {0, 1, -1, 2, -2, 0x7FFF, 0x8000, -0x8000, -0x8001, 0xFFFF, 0x10000, -0x10000,
+                                    0x10001, 0x18000, -0x18000, 0x7FFFFFFF, -0x7FFFFFFF, INT32_MIN, 0x40000000,
+                                    -0x40000000, 0x00B504F3, -0x00B504F3, 0x00B504F4};
+    size_t i;
+    size_t j;
+    long trial;
+    int32_t value;
+
+    for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+    {
+        for (j = 0; j < sizeof(edges) / sizeof(edges[0]); j++)
+        {
+            check_q16_16(edges[i], edges[j]);
+        }
+    }
+    for (trial = 0; trial < RANDOM_TRIALS; trial++)
+    {
+        check_q16_16(random_operand(), random_operand());
+    }
+
+    // Exact halves round up, on both sides of zero
+    check(q16_16_mul(Q16_16(0.5), 1) == 1, "q16_16_mul half", Q16_16(0.5), 1, 1, q16_16_mul(Q16_16(0.5), 1));
+    check(q16_16_mul(Q16_16(-0.5), 1) == 0, "q16_16_mul -half", Q16_16(-0.5), 1, 0, q16_16_mul(Q16_16(-0.5), 1));
+    check(q16_16_scale(3, Q16_16(0.5)) == 2, "q16_16_scale half", 3, Q16_16(0.5), 2, q16_16_scale(3, Q16_16(0.5)));
+    check(q16_16_scale(-3, Q16_16(0.5)) == -1, "q16_16_scale -half", -3, Q16_16(0.5), -1,
+          q16_16_scale(-3, Q16_16(0.5)));
+
+    for (value = -0x20000; value <= 0x20000; value++)
+    {
+        int64_t expected = saturate((int64_t)value * Q16_16_ONE, INT32_MIN, INT32_MAX);
+
+        check(q16_16_from_int(value) == expected, "q16_16_from_int", value, 0, expected, q16_16_from_int(value));
+        if (value >= INT16_MIN && value <= INT16_MAX)
+        {
+            check(q16_16_to_int(q16_16_from_int(value)) == value, "q16_16_to_int", value, 0, value,
+                  q16_16_to_int(q16_16_from_int(value)));
+        }
+    }
+    check(q16_16_to_int(Q16_16(-0.5)) == -1, "q16_16_to_int", Q16_16(-0.5), 0, -1, q16_16_to_int(Q16_16(-0.5)));
+}
+
+static void test_q8_8(void)
+{
+    int32_t a;
+    int32_t b;
+
+    for (a = INT16_MIN; a <= INT16_MAX; a += 7)
+    {
+        for (b = INT16_MIN; b <= INT16_MAX; b += 13)
+        {
+            int64_t sum = saturate(a + b, INT16_MIN, INT16_MAX);
+            int64_t difference = saturate(a - b, INT16_MIN, INT16_MAX);
+            int64_t product = saturate(floor_shift((int64_t)a * b + Q8_8_ONE / 2, 8), INT16_MIN, INT16_MAX);
+
+            check(q8_8_add(a, b) == sum, "q8_8_add", a, b, sum, q8_8_add(a, b));
+            check(q8_8_sub(a, b) == difference, "q8_8_sub", a, b, difference, q8_8_sub(a, b));
+            check(q8_8_mul(a, b) == product, "q8_8_mul", a, b, product, q8_8_mul(a, b));
+        }
+    }
+    for (a = -300; a <= 300; a++)
+    {
+        int64_t expected = saturate((int64_t)a * Q8_8_ONE, INT16_MIN, INT16_MAX);
+
+        check(q8_8_from_int(a) == expected, "q8_8_from_int", a, 0, expected, q8_8_from_int(a));
+    }
+    check(q8_8_mul(Q8_8(0.5), 1) == 1, "q8_8_mul half", Q8_8(0.5), 1, 1, q8_8_mul(Q8_8(0.5), 1));
+    check(q8_8_mul(Q8_8(-0.5), 1) == 0, "q8_8_mul -half", Q8_8(-0.5), 1, 0, q8_8_mul(Q8_8(-0.5), 1));
+    check(fixed_clamp(-5, 0, 9) == 0 && fixed_clamp(12, 0, 9) == 9 && fixed_clamp(4, 0, 9) == 4, "fixed_clamp", 0, 9,
+          0, 0);
+}
+
+static void check_division(uint32_t x, uint32_t d)
+{
+    uint32_t recip = FIXED_RECIP(d);
+
+    check(fixed_udiv((uint16_t)x, (uint16_t)d, recip) == x / d, "fixed_udiv", x, d, x / d,
+          fixed_udiv((uint16_t)x, (uint16_t)d, recip));
+    if (x <= 32767 && d <= 32767)
+    {
+        int32_t sx = (int32_t)x;
+
+        check(fixed_sdiv((int16_t)sx, (uint16_t)d, recip) == sx / (int32_t)d, "fixed_sdiv", sx, d, sx / (int32_t)d,
+              fixed_sdiv((int16_t)sx, (uint16_t)d, recip));
+        check(fixed_sdiv((int16_t)-sx, (uint16_t)d, recip) == -sx / (int32_t)d, "fixed_sdiv", -sx, d,
+              -sx / (int32_t)d, fixed_sdiv((int16_t)-sx, (uint16_t)d, recip));
+    }
+}
+
+static void test_division(void)
+{
+    uint32_t x;
+    uint32_t d;
+    long trial;
+
+    for (d = 1; d <= 1000; d++)
+    {
+        for (x = 0; x <= 0xFFFF; x++)
+        {
+            check_division(x, d);
+        }
+    }
+    for (trial = 0; trial < RANDOM_TRIALS; trial++)
+    {
+        check_division(random32() & 0xFFFF, 1 + random32() % 0xFFFF);
+    }
+    check(fixed_sdiv(INT16_MIN, 1, FIXED_RECIP(1)) == INT16_MIN, "fixed_sdiv", INT16_MIN, 1, INT16_MIN,
+          fixed_sdiv(INT16_MIN, 1, FIXED_RECIP(1)));
+}
+
+static void test_format(void)
+{
+    char out[FIXED_DIGITS_MAX + 1];
+    char expected[16];
+    uint32_t value;
+    unsigned char width;
+
+    for (value = 0; value <= 0xFFFF; value++)
+    {
+        for (width = 1; width <= FIXED_DIGITS_MAX; width++)
+        {
+            memset(out, 0, sizeof(out));
+            fixed_format(out, (uint16_t)value, width);
+            snprintf(expected, sizeof(expected), "%05" PRIu32, value);
+            if (strcmp(out, expected + FIXED_DIGITS_MAX - width) != 0)
+            {
+                check(0, "fixed_format", value, width, atol(expected + FIXED_DIGITS_MAX - width), atol(out));
+            }
+        }
+    }
+}
+
+static void check_format_long(uint32_t value)
+{
+    char out[FIXED_LONG_DIGITS_MAX + 1];
+    char expected[16];
+    unsigned char width;
+
+    snprintf(expected, sizeof(expected), "%010" PRIu32, value);
+    for (width = 1; width <= FIXED_LONG_DIGITS_MAX; width++)
+    {
+        memset(out, 0, sizeof(out));
+        fixed_format_long(out, value, width);
+        if (strcmp(out, expected + FIXED_LONG_DIGITS_MAX - width) != 0)
+        {
+            check(0, "fixed_format_long", value, width, atoll(expected + FIXED_LONG_DIGITS_MAX - width), atoll(out));
+        }
+    }
+}
+
+static void test_format_long(void)
+{
+    uint32_t power = 1;
+    unsigned char digits;
+    long trial;
+
+    for (digits = 1; digits < FIXED_LONG_DIGITS_MAX; digits++)
+    {
+        power *= 10;
+        check_format_long(power - 1); // All nines
+        check_format_long(power);
+    }
+    check_format_long(UINT32_MAX);
+    for (trial = 0; trial < RANDOM_TRIALS; trial++)
+    {
+        check_format_long(random32() >> (random32() & 31));
+    }
+}
+
+int main(void)
+{
+    test_q16_16();
+    test_q8_8();
+    test_division();
+    test_format();
+    test_format_long();
+    printf("%ld failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""Static RAM/FRAM footprint and worst-case stack depth of a firmware build.
+
+Reads the object files of one firmware image, built with -fstack-usage and -ffunction-sections so that every function
+has a frame size in a .su file next to its object and every call carries a relocation:
+
+  - per-symbol RAM and FRAM use, from the section each symbol lives in. .bss is RAM only, .data is RAM plus its
+    initial values in FRAM, .persistent and everything read-only is FRAM only;
+  - the deepest call chain from main() and from every interrupt handler, from the frame sizes and the call graph in
+    the disassembly. Indirect calls are taken to reach any function whose address is stored in data, such as the
+    keypad action table. Handlers do not nest (none re-enables interrupts), so the worst case is main's chain plus
+    the deepest handler chain plus the PC and SR pushed on entry.
+
+Interrupt handlers are the functions declared __interrupt in the given sources.
+
+Usage: footprint.py [--mcu msp430fr2355|msp430fr2310] [--tools PREFIX] --src DIR [--src DIR ...] OBJECT...
+"""
+
+import argparse
+import collections
+import glob
+import os
+import re
+import subprocess
+import sys
+
+MCUS = {
+    'msp430fr2355': {'ram': 4096, 'fram': 32768},
+    'msp430fr2310': {'ram': 1024, 'fram': 4096},
+}
+INTERRUPT_ENTRY_BYTES = 4  # PC and SR pushed by the CPU
+CALL_RE = re.compile(r'\s(call|calla|callq)\s+(.*)$')
+JUMP_RE = re.compile(r'\s(br|bra|jmp|jmpq)\s+(.*)$')
+FUNCTION_RE = re.compile(r'^[0-9a-f]+ <([^>]+)>:$')
+RELOC_RE = re.compile(r'\bR_[A-Z0-9_]+\s+([^\s+-]+)')
+TARGET_RE = re.compile(r'<([^>+]+)(\+0x[0-9a-f]+)?>')
+ISR_RE = re.compile(r'__interrupt\s+void\s+(\w+)\s*\(')
+
+
+def run(command):
+    return subprocess.run(command, check=True, capture_output=True, text=True).stdout
+
+
+def section_kind(name, flags, section_type):
+    """RAM, FRAM or both for an allocated section, None if it takes no memory."""
+    if 'A' not in flags:
+        return None
+    if name.startswith('.persistent') or 'W' not in flags:
+        return 'fram'
+    return 'ram' if section_type == 'NOBITS' else 'both'
+
+
+def read_sections(tools, path):
+    sections = {}
+    for line in run([tools + 'readelf', '-SW', path]).splitlines():
+        match = re.match(r'\s*\[\s*(\d+)\]\s+(\S+)\s+(\S+)\s+\S+\s+\S+\s+\S+\s+\S+\s+(\S*)', line)
+        if match:
+            sections[match.group(1)] = (match.group(2), section_kind(match.group(2), match.group(4), match.group(3)))
+    return sections
+
+
+def read_symbols(tools, path):
+    """Data and code symbols of one object: (name, section, kind, size)."""
+    sections = read_sections(tools, path)
+    symbols = []
+    for line in run([tools + 'readelf', '-sW', path]).splitlines():
+        fields = line.split()
+        if len(fields) < 8 or not fields[0].endswith(':') or fields[3] not in ('OBJECT', 'FUNC'):
+            continue
+        size = int(fields[2], 0)
+        section = sections.get(fields[6])
+        if size == 0 or section is None or section[1] is None:
+            continue
+        symbols.append((fields[7], section[0], section[1], size))
+    return symbols
+
+
+def read_frames(path):
+    """Frame size of each function from the .su file next to an object."""
+    frames = {}
+    dynamic = set()
+    su = os.path.splitext(path)[0] + '.su'
+    if not os.path.exists(su):
+        sys.exit(f'{su} missing, build with -fstack-usage')
+    with open(su) as lines:
+        for line in lines:
+            location, size, qualifier = line.rstrip('\n').split('\t')
+            name = location.rsplit(':', 1)[1]
+            frames[name] = int(size)
+            if qualifier.startswith('dynamic'):
+                dynamic.add(name)
+    return frames, dynamic
+
+
+def read_calls(tools, path, functions):
+    """Direct callees of each function in an object, the functions making indirect calls and address-taken functions."""
+    calls = collections.defaultdict(set)
+    indirect = set()
+    current = None
+    for line in run([tools + 'objdump', '-drw', path]).splitlines():
+        function = FUNCTION_RE.match(line)
+        if function:
+            current = function.group(1)
+            continue
+        call = CALL_RE.search(line)
+        jump = JUMP_RE.search(line)
+        if current is None or not (call or jump):
+            continue
+        operand = (call or jump).group(2)
+        reloc = RELOC_RE.search(operand)
+        target = TARGET_RE.search(operand)
+        if reloc:
+            name = reloc.group(1)
+        elif target and not target.group(2):
+            name = target.group(1)
+        else:
+            name = None
+        if name in functions and name != current:
+            calls[current].add(name)
+        elif name is None and re.match(r'\*|@?r\d+|-?\d*\(r\d+\)', operand):
+            indirect.add(current)
+
+    taken = set()
+    section = None
+    for line in run([tools + 'objdump', '-rw', path]).splitlines():
+        header = re.match(r'RELOCATION RECORDS FOR \[(.+)\]:', line)
+        if header:
+            section = header.group(1)
+            continue
+        fields = line.split()
+        if len(fields) == 3 and section and not section.startswith(('.text', '.rela.text', '__interrupt_vector')):
+            name = re.split(r'[+-]', fields[2])[0]
+            if name in functions:
+                taken.add(name)
+    return calls, indirect, taken
+
+
+def deepest(name, frames, calls, stack, memo):
+    """Deepest chain from a function: (bytes, chain), or None for recursion."""
+    if name in memo:
+        return memo[name]
+    if name in stack:
+        return None
+    stack.add(name)
+    best = (0, [])
+    for callee in calls.get(name, ()):
+        result = deepest(callee, frames, calls, stack, memo)
+        if result is None:
+            stack.discard(name)
+            return None
+        if result[0] > best[0]:
+            best = result
+    stack.discard(name)
+    memo[name] = (frames.get(name, 0) + best[0], [name] + best[1])
+    return memo[name]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--mcu', default='msp430fr2355', choices=sorted(MCUS))
+    parser.add_argument('--tools', default='msp430-elf-', help='binutils prefix')
+    parser.add_argument('--src', action='append', default=[], help='source directory to find __interrupt handlers in')
+    parser.add_argument('--top', type=int, default=0, help='only list the largest N symbols')
+    parser.add_argument('objects', nargs='+')
+    args = parser.parse_args()
+    budget = MCUS[args.mcu]
+
+    symbols = []
+    frames = {}
+    dynamic = set()
+    for path in args.objects:
+        symbols += read_symbols(args.tools, path)
+        object_frames, object_dynamic = read_frames(path)
+        frames.update(object_frames)
+        dynamic |= object_dynamic
+
+    calls = collections.defaultdict(set)
+    indirect = set()
+    taken = set()
+    for path in args.objects:
+        object_calls, object_indirect, object_taken = read_calls(args.tools, path, frames)
+        for caller, callees in object_calls.items():
+            calls[caller] |= callees
+        indirect |= object_indirect
+        taken |= object_taken
+
+    handlers = []
+    for directory in args.src:
+        for source in sorted(glob.glob(os.path.join(directory, '*.c'))):
+            with open(source) as text:
+                handlers += [name for name in ISR_RE.findall(text.read()) if name in frames]
+    for caller in indirect:
+        calls[caller] |= taken - set(handlers)
+
+    # Symbols
+    print(f'{"symbol":32} {"section":24} {"ram":>6} {"fram":>6}')
+    ram = fram = 0
+    listed = sorted(symbols, key=lambda symbol: -symbol[3])
+    for index, (name, section, kind, size) in enumerate(listed):
+        symbol_ram = size if kind in ('ram', 'both') else 0
+        symbol_fram = size if kind in ('fram', 'both') else 0
+        ram += symbol_ram
+        fram += symbol_fram
+        if not args.top or index < args.top:
+            print(f'{name:32} {section[:24]:24} {symbol_ram:6} {symbol_fram:6}')
+    print(f'{"total":57} {ram:6} {fram:6}')
+
+    # Stack
+    print(f'\n{"entry":32} {"stack":>6}  deepest chain')
+    memo = {}
+    depths = {}
+    for entry in ['main'] + handlers:
+        result = deepest(entry, frames, calls, set(), memo)
+        if result is None:
+            print(f'{entry:32} {"unbounded (recursion)":>6}')
+            continue
+        depth = result[0] + (INTERRUPT_ENTRY_BYTES if entry != 'main' else 0)
+        depths[entry] = depth
+        print(f'{entry:32} {depth:6}  {" > ".join(result[1])}')
+    for name in sorted(dynamic):
+        print(f'warning: {name} has a dynamic frame, its size is a lower bound')
+
+    worst_handler = max((depths[name] for name in handlers if name in depths), default=0)
+    stack = depths.get('main', 0) + worst_handler
+    print(f'\nworst-case stack {stack} bytes (main {depths.get("main", 0)} + deepest handler {worst_handler})')
+    print(f'RAM {ram} static + {stack} stack = {ram + stack} of {budget["ram"]}, {budget["ram"] - ram - stack} free')
+    print(f'FRAM {fram} of {budget["fram"]} (code and constants in the objects, no runtime library)')
+    return 0 if ram + stack <= budget['ram'] and len(depths) == len(handlers) + 1 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
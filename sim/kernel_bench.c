@@ -0,0 +1,570 @@
+/**
+ * @file
+ * @brief Micro-benchmarks for the controller and LCD hot paths.
+ *
+ * Each kernel is the production function from controller/app or lcd, called in a loop over varied inputs. On the host
+ * the result is nanoseconds per call. Built for the MSP430 the same loops are timed with Timer_B3 clocked from SMCLK,
+ * which equals MCLK after reset, so the result is CPU cycles per call. Timer_B3 is only 16 bits, so its overflows are
+ * counted in an interrupt and the count is extended to 32 bits; a loop may run for any number of cycles.
+ *
+ * On the host each kernel is timed BENCH_RUNS times, interleaved with the others, and keeps its fastest run: other load
+ * on the host only ever adds time. A single timing varied by up to 80% between runs of unchanged code; the fastest of
+ * nine stays within 20%.
+ *
+ * The results are printed as "name value" lines, which is also the baseline file format. On the MSP430 they go out of
+ * the back-channel UART at 9600 baud. On the host, given a baseline file and a threshold in percent, any kernel slower
+ * than its baseline by more than the threshold is reported and the program exits with status 1. A kernel over the
+ * threshold is first timed for up to BENCH_RETRIES more rounds, so a burst of load has to last the whole retry to
+ * raise a false regression. With --compare, two result files are compared without running anything, which is how
+ * results captured from the target are checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keypad.h"
+#include "leds.h"
+#include "lm19.h"
+#include "lm92.h"
+#include "lcd_format.h"
+#include "lcd_screen.h"
+#include "stats.h"
+#include "uart_cmd.h"
+#include "zone.h"
+
+#ifdef __MSP430__
+#include <msp430.h>
+#define BENCH_ITERATIONS 256
+#define BENCH_RUNS 1 // Cycle counts repeat exactly
+#define BENCH_UNIT "cycles/op"
+#else
+#include <time.h>
+#define BENCH_ITERATIONS 200000L
+#define BENCH_RUNS 9    // Each kernel keeps its fastest run, which is the one least disturbed by the rest of the host
+#define BENCH_RETRIES 3 // Further rounds of BENCH_RUNS while a kernel is over the threshold, before it is reported
+#define BENCH_UNIT "ns/op"
+
+volatile unsigned char P1OUT;
+volatile unsigned char P5OUT;
+volatile unsigned char P6OUT;
+#endif
+
+#define MAX_KERNELS 16
+
+/** LCD bus writes issued by lcd_screen_flush(), counted instead of driving pins. */
+static long lcd_writes;
+
+void lcd_send_command(char command)
+{
+    (void)command;
+    lcd_writes++;
+}
+
+void lcd_send_data(char data)
+{
+    (void)data;
+    lcd_writes++;
+}
+
+/** Keeps results alive so the compiler cannot drop the work being measured. */
+volatile long bench_sink;
+
+struct bench_result
+{
+    const char *name;
+    double per_op;
+};
+
+static struct bench_result results[MAX_KERNELS];
+static int result_count = 0;
+
+#ifdef __MSP430__
+/** Timer_B3 overflows since timer_start() */
+static volatile unsigned int timer_overflows;
+
+#pragma vector = TIMER3_B1_VECTOR
+__interrupt void ISR_TB3_Overflow(void)
+{
+    if (TB3IV == TBIV__TBIFG)
+    {
+        timer_overflows++;
+    }
+}
+
+static void timer_start(void)
+{
+    timer_overflows = 0;
+    TB3CTL = TBSSEL__SMCLK | MC__CONTINUOUS | TBCLR | TBIE;
+}
+
+/**
+ * Elapsed SMCLK cycles, the overflow count above the 16-bit counter. Each overflow interrupt adds its own few dozen
+ * cycles, under 0.1% of the 65536 it counts.
+ */
+static double timer_stop(void)
+{
+    unsigned long cycles;
+
+    __disable_interrupt();
+    TB3CTL &= ~MC;
+    cycles = TB3R;
+    if (TB3CTL & TBIFG)
+    {
+        TB3CTL &= ~TBIFG; // Wrapped after the last interrupt could run
+        timer_overflows++;
+    }
+    cycles += (unsigned long)timer_overflows << 16;
+    __enable_interrupt();
+    return cycles;
+}
+
+/**
+ * Send printf() output out of eUSCI_A1, the LaunchPad back-channel UART. Replaces the C library's write().
+ */
+int write(int fd, const char *buffer, int length)
+{
+    int i;
+
+    (void)fd;
+    for (i = 0; i < length; i++)
+    {
+        if (buffer[i] == '\n')
+        {
+            while (!(UCA1IFG & UCTXIFG))
+            {
+            }
+            UCA1TXBUF = '\r';
+        }
+        while (!(UCA1IFG & UCTXIFG))
+        {
+        }
+        UCA1TXBUF = buffer[i];
+    }
+    return length;
+}
+
+/**
+ * 9600 8N1 from the 1 MHz reset SMCLK, as main.c sets it up.
+ */
+static void uart_init(void)
+{
+    P4SEL0 |= BIT2 | BIT3;
+    P4SEL1 &= ~(BIT2 | BIT3);
+    UCA1CTLW0 = UCSWRST | UCSSEL__SMCLK;
+    UCA1BRW = 6;
+    UCA1MCTLW = 0x2000 | UCBRF_8 | UCOS16;
+    UCA1CTLW0 &= ~UCSWRST;
+    PM5CTL0 &= ~LOCKLPM5;
+}
+#else
+static struct timespec bench_start;
+
+static void timer_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &bench_start);
+}
+
+static double timer_stop(void)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - bench_start.tv_sec) * 1e9 + (end.tv_nsec - bench_start.tv_nsec);
+}
+#endif
+
+/**
+ * Keep a kernel's result, or its faster one if it has run before.
+ */
+static void record(const char *name, double total)
+{
+    int i;
+
+    for (i = 0; i < result_count && strcmp(results[i].name, name) != 0; i++)
+    {
+    }
+    if (i == result_count)
+    {
+        results[result_count].name = name;
+        results[result_count].per_op = total / BENCH_ITERATIONS;
+        result_count++;
+    }
+    else if (total / BENCH_ITERATIONS < results[i].per_op)
+    {
+        results[i].per_op = total / BENCH_ITERATIONS;
+    }
+}
+
+static void bench_lm19(void)
+{
+    long i;
+    long sum = 0;
+
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        sum += lm19_tenths(1800 + (i & 0x1FF));
+    }
+    record("lm19_convert", timer_stop());
+    bench_sink += sum;
+}
+
+static void bench_lm92(void)
+{
+    unsigned char data[2];
+    long i;
+    long sum = 0;
+
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        data[0] = (i & 0x04) ? 0xFE : 0x0B + (i & 0x03); // Both signs
+        data[1] = (unsigned char)(i << 3);
+        sum += lm92_sixteenths_to_tenths(lm92_sixteenths(data)) + lm92_status(data);
+    }
+    record("lm92_convert", timer_stop());
+    bench_sink += sum;
+}
+
+static void bench_leds(void)
+{
+    long i;
+
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        update_leds((int)(i & 0xFF));
+    }
+    record("update_leds", timer_stop());
+    bench_sink += P5OUT + P6OUT;
+}
+
+static void bench_led_frame(void)
+{
+    static const enum leds_mode modes[] = {LEDS_HEAT, LEDS_COOL, LEDS_DISTANCE, LEDS_DISTANCE};
+    struct leds leds;
+    long i;
+    long sum = 0;
+
+    leds_init(&leds);
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        // A mode change every 64 frames, the distance bar sweeping both signs up to 51.1 C
+        leds_select(&leds, modes[(i >> 6) & 3]);
+        leds.error_tenths = (int)(i & 0x3FF) - 0x200;
+        sum += leds_frame(&leds);
+    }
+    record("led_frame", timer_stop());
+    bench_sink += sum;
+}
+
+static void bench_lcd_format(void)
+{
+    char temperature[LCD_TEMPERATURE_LENGTH];
+    char op_time[LCD_OP_TIME_LENGTH];
+    long i;
+
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        lcd_format_temperature(temperature, (int)(i % 1000) - 100);
+        lcd_format_op_time(op_time, (int)(i % 1000));
+    }
+    record("lcd_format", timer_stop());
+    bench_sink += temperature[1] + op_time[2];
+}
+
+/**
+ * Key presses covering mode changes, setpoint entry with tenths and window entry ("A*25*5#010#C").
+ */
+static void bench_keypad(void)
+{
+    static const unsigned char keys[] = {3, 12, 1, 5, 12, 5, 14, 13, 0, 13, 14, 11};
+    struct keypad_fsm fsm;
+    long i;
+
+    keypad_init(&fsm);
+    fsm.state = UNLOCKED;
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        keypad_dispatch(&fsm, keys[i % sizeof(keys)]);
+    }
+    record("keypad_dispatch", timer_stop());
+    bench_sink += fsm.setpoint_tenths + fsm.window_size;
+}
+
+/**
+ * One zone's work per control period: an LM92 and an LM19 reading into full windows, then the control decision.
+ */
+static void bench_zone(void)
+{
+    struct energy_budget budget;
+    struct zone zone = {.sources = {{SOURCE_LM92, 0x48}, {SOURCE_ADC, 1}}, .mode = MATCH, .port = &P1OUT,
+                        .heat_pin = BIT7, .cool_pin = BIT6, .budget = &budget};
+    long i;
+
+    energy_init(&budget, Q16_16(ENERGY_RATED_W * 0.5), 1, 24, 3000);
+    for (i = 0; i < WINDOW_MAX; i++)
+    {
+        zone_push(&zone, ZONE_PLATE, 400, 3);
+        zone_push(&zone, ZONE_AMBIENT, 2000, 3);
+    }
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        unsigned int epoch = zone_begin(&zone, (unsigned int)i);
+
+        zone_sample(&zone, epoch, ZONE_AMBIENT, 1990 + (int)(i & 0x1F), (unsigned int)i + 3);
+        if (zone_sample(&zone, epoch, ZONE_PLATE, 400 + (int)(i & 0x0F), (unsigned int)i + 12) &&
+            zone_deliver(&zone, 3))
+        {
+            zone_control(&zone);
+            zone_actuated(&zone, (unsigned int)i + 12);
+        }
+    }
+    record("zone_update", timer_stop());
+    bench_sink += zone.drive;
+}
+
+/**
+ * A plate sample into the running statistics, then the values the controller reads back each period.
+ */
+static void bench_stats(void)
+{
+    struct stats stats;
+    long i;
+    long sum = 0;
+
+    stats_reset(&stats);
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        stats_push(&stats, 250 + (int)((i * 7) % 23));
+        sum += stats_slope(&stats) + stats_min(&stats) + stats_max(&stats);
+    }
+    record("stats_update", timer_stop());
+    bench_sink += sum;
+}
+
+/**
+ * A full status query over the UART: the command bytes in, then every reply byte out, as the two ISRs see them.
+ */
+static void bench_uart(void)
+{
+    static const char command[] = "Q 0\r";
+    struct energy_budget budget;
+    struct zone zones[1] = {{.sources = {{SOURCE_LM92, 0x48}, {SOURCE_ADC, 1}}, .mode = MATCH, .port = &P1OUT,
+                             .heat_pin = BIT7, .cool_pin = BIT6, .budget = &budget}};
+    struct keypad_fsm keypad;
+    struct uart_cmd uart;
+    long i;
+    long sum = 0;
+    int c;
+    unsigned char j;
+
+    energy_init(&budget, Q16_16(ENERGY_RATED_W * 0.5), 1, 24, 3000);
+    keypad_init(&keypad);
+    uart_cmd_init(&uart, &keypad, zones, 1);
+    for (i = 0; i < STATS_WINDOW; i++)
+    {
+        stats_push(&zones[0].stats[ZONE_PLATE], -250 + (int)(i * 37)); // Long numbers in every field
+    }
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        for (j = 0; j < sizeof(command) - 1; j++)
+        {
+            uart_cmd_receive(&uart, command[j]);
+        }
+        while ((c = uart_cmd_transmit(&uart)) >= 0)
+        {
+            sum += c;
+        }
+    }
+    record("uart_query", timer_stop());
+    bench_sink += sum;
+}
+
+/**
+ * One LCD refresh as lcd_write() does it: a temperature and the op time tick, the graphics follow the new sample.
+ */
+static void bench_lcd_render(void)
+{
+    static const char sparkline[] = {LCD_GLYPH(0), LCD_GLYPH(1), LCD_GLYPH(2), '\0'};
+    static const char error_bar[] = {LCD_GLYPH(3), LCD_GLYPH(4), '\0'};
+    char temperature[LCD_TEMPERATURE_LENGTH];
+    char op_time[LCD_OP_TIME_LENGTH];
+    long i;
+
+    lcd_screen_invalidate();
+    lcd_writes = 0;
+    timer_start();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        int tenths = 250 + (int)((i * 7) % 23);
+
+        lcd_screen_begin();
+        lcd_screen_put(0, 0, "match");
+        lcd_screen_history_push(tenths);
+        lcd_screen_sparkline(0, 3);
+        lcd_screen_error_bar(3, tenths - 255, 5);
+        lcd_screen_put(0, 5, sparkline);
+        lcd_screen_put(0, 8, "A:");
+        lcd_screen_put(0, 10, "22.0\xDF" "C");
+        lcd_screen_put(1, 0, "3");
+        lcd_format_op_time(op_time, (int)(i % 1000));
+        lcd_screen_put(1, 2, op_time);
+        lcd_screen_put(1, 6, error_bar);
+        lcd_screen_put(1, 8, "P:");
+        lcd_format_temperature(temperature, tenths);
+        lcd_screen_put(1, 10, temperature);
+        lcd_screen_flush();
+    }
+    record("lcd_render", timer_stop());
+    record("lcd_render_writes", (double)lcd_writes);
+}
+
+#ifndef __MSP430__
+/**
+ * Read a results file.
+ *
+ * @return: Number of results read, or -1 if the file cannot be opened.
+ */
+static int read_results(const char *path, struct bench_result *read, char names[][32])
+{
+    char line[64];
+    int count = 0;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    while (count < MAX_KERNELS && fgets(line, sizeof(line), file) != NULL)
+    {
+        if (sscanf(line, "%31s %lf", names[count], &read[count].per_op) == 2 && names[count][0] != '#')
+        {
+            read[count].name = names[count];
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+/**
+ * Compare results against a baseline file.
+ *
+ * @param: report Non-zero to print each regression.
+ *
+ * @return: Number of kernels slower than baseline by more than threshold percent, or -1 if the baseline cannot be
+ *          read.
+ */
+static int compare_baseline(const char *path, const struct bench_result *current, int count, double threshold,
+                            int report)
+{
+    static struct bench_result baseline[MAX_KERNELS];
+    static char names[MAX_KERNELS][32];
+    int baseline_count = read_results(path, baseline, names);
+    int regressions = 0;
+    int i;
+    int j;
+
+    for (i = 0; i < baseline_count; i++)
+    {
+        for (j = 0; j < count; j++)
+        {
+            if (strcmp(baseline[i].name, current[j].name) == 0 &&
+                current[j].per_op > baseline[i].per_op * (1.0 + threshold / 100.0))
+            {
+                if (report)
+                {
+                    printf("REGRESSION %s: %.2f -> %.2f\n", current[j].name, baseline[i].per_op, current[j].per_op);
+                }
+                regressions++;
+            }
+        }
+    }
+    return (baseline_count < 0) ? -1 : regressions;
+}
+#endif
+
+/**
+ * Time every kernel BENCH_RUNS times.
+ */
+static void bench_all(void)
+{
+    int run;
+
+    for (run = 0; run < BENCH_RUNS; run++)
+    {
+        bench_lm19();
+        bench_lm92();
+        bench_leds();
+        bench_led_frame();
+        bench_lcd_format();
+        bench_keypad();
+        bench_zone();
+        bench_stats();
+        bench_uart();
+        bench_lcd_render();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+#ifndef __MSP430__
+    int retry;
+#endif
+
+#ifdef __MSP430__
+    (void)argc;
+    (void)argv;
+    WDTCTL = WDTPW | WDTHOLD;
+    uart_init();
+    __enable_interrupt();
+#else
+    if (argc == 5 && strcmp(argv[1], "--compare") == 0)
+    {
+        static struct bench_result current[MAX_KERNELS];
+        static char names[MAX_KERNELS][32];
+        int count = read_results(argv[3], current, names);
+
+        return (count >= 0 && compare_baseline(argv[2], current, count, atof(argv[4]), 1) == 0) ? 0 : 1;
+    }
+#endif
+
+    bench_all();
+#ifndef __MSP430__
+    for (retry = 0; argc >= 3 && retry < BENCH_RETRIES; retry++)
+    {
+        if (compare_baseline(argv[1], results, result_count, atof(argv[2]), 0) <= 0)
+        {
+            break;
+        }
+        bench_all(); // A busy host only ever makes a kernel slower, so more runs can only bring it back down
+    }
+#endif
+
+    printf("# %s\n", BENCH_UNIT);
+    for (i = 0; i < result_count; i++)
+    {
+        printf("%s %.2f\n", results[i].name, results[i].per_op);
+    }
+
+#ifdef __MSP430__
+    while (1)
+    {
+    }
+#else
+    if (argc >= 3)
+    {
+        return compare_baseline(argv[1], results, result_count, atof(argv[2]), 1) == 0 ? 0 : 1;
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @brief Host checks of the setpoint and window entries keypad_dispatch() stores.
+ *
+ * Each check presses a string of keys, named by their legends, on a state machine already unlocked and in OFF, and
+ * compares the setpoint, window and state left behind with what the rules in controller/app/keypad.h say they should
+ * be. The state machine carries over from one check to the next, so a check that should leave a value unchanged
+ * compares it with what the previous check stored.
+ *
+ * Each failure is printed with the keys pressed; the exit status is 1 if there were any.
+ */
+
+#include <stdio.h>
+
+#include "keypad.h"
+
+static int failures;
+
+/**
+ * Press a sequence of keys and compare the stored setpoint, window and state.
+ */
+static void check(const char *name, struct keypad_fsm *fsm, const char *keys, int setpoint_tenths,
+                  unsigned char window_size, enum State state)
+{
+    for (; *keys != '\0'; keys++)
+    {
+        keypad_dispatch(fsm, (unsigned char)keypad_key(*keys));
+    }
+    if (fsm->setpoint_tenths != setpoint_tenths || fsm->window_size != window_size || fsm->state != state)
+    {
+        printf("FAIL %s\n  expected: setpoint %d window %u state %d\n  actual:   setpoint %d window %u state %d\n",
+               name, setpoint_tenths, window_size, state, fsm->setpoint_tenths, fsm->window_size, fsm->state);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    struct keypad_fsm fsm;
+
+    keypad_init(&fsm);
+    check("unlock", &fsm, "2659D", 0, 3, OFF);
+
+    // Setpoint entry: whole degrees, then '*' and one tenths digit
+    check("setpoint", &fsm, "*25*5#", 255, 3, OFF);
+    check("whole degrees", &fsm, "*31#", 310, 3, OFF);
+    check("zero", &fsm, "*0#", 0, 3, OFF);
+    check("setpoint again", &fsm, "*25*5#", 255, 3, OFF);
+
+    // Nothing entered: the setpoint stays, as an empty window entry leaves the window
+    check("empty setpoint", &fsm, "*#", 255, 3, OFF);
+    check("point only", &fsm, "**#", 255, 3, OFF);
+    check("tenths only", &fsm, "**7#", 7, 3, OFF);
+
+    // Digits past 99.9 C are ignored, not wrapped
+    check("setpoint overflow", &fsm, "*123#", 120, 3, OFF);
+
+    // Window entry: 1 - WINDOW_MAX, empty and zero leave the window as it was
+    check("window", &fsm, "05#", 120, 5, OFF);
+    check("empty window", &fsm, "0#", 120, 5, OFF);
+    check("zero window", &fsm, "00#", 120, 5, OFF);
+    check("window overflow", &fsm, "011#", 120, 1, OFF);
+
+    // A mode key abandons an entry and stores nothing
+    check("abandoned setpoint", &fsm, "*4A", 120, 1, HEAT);
+    check("abandoned window", &fsm, "08D", 120, 1, OFF);
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,483 @@
+/**
+ * @file
+ * @brief Host-side closed-loop simulation of the Peltier controller.
+ *
+ * A first-order-plus-dead-time model of the Peltier plate, coupled to a heatsink that relaxes to ambient, is driven by
+ * the controller glue from controller/app, as sim/trace_replay.c drives it: every sample period a zone epoch is
+ * started with zone_begin(), the LM92 reading (1/16 degree C) and the LM19 reading (ADC counts) go in through
+ * zone_sample(), and a completed pair goes to control_pair_done(), which averages, decides, schedules within the power
+ * budget and sets the outputs exactly as on the board. The heartbeat runs control_second(). The zone, its pins and its
+ * budget come from control_configure(); the mode, setpoint and window are set on the keypad state machine.
+ *
+ * Every scenario reports rise time, overshoot, steady-state error, the number of drive changes and the electrical
+ * energy used. Plant parameters may be overridden on the command line as name=value pairs, see sim/README.md.
+ *
+ * A second table compares MATCH_SET under a range of power budgets: the energy to reach the setpoint and the power to
+ * hold it.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "control.h"
+#include "energy.h"
+#include "keypad.h"
+#include "leds.h"
+#include "lm19.h"
+#include "peltier.h"
+#include "zone.h"
+
+#define SIM_DT_S 0.01          // Integration step
+#define SAMPLE_PERIOD_S 0.5    // TB2 period, 16384 ACLK counts
+#define HEARTBEAT_PERIOD_S 1.0 // TB1 period, drives the mode timer
+#define MAX_DEAD_STEPS 2000    // Longest dead time the delay line can hold (20 s)
+#define ACLK_HZ 32768.0        // Clock of zone_sample() time stamps
+
+volatile unsigned char P1OUT;
+volatile unsigned char P5OUT;
+volatile unsigned char P6OUT;
+
+/**
+ * Plant, sensor and controller parameters.
+ */
+struct sim_params
+{
+    /** Ambient air temperature, degrees C */
+    double ambient_c;
+
+    /** Plate time constant, seconds */
+    double tau_plate_s;
+
+    /** Heatsink time constant, seconds */
+    double tau_sink_s;
+
+    /** Delay between a drive change and the plate responding, seconds */
+    double dead_time_s;
+
+    /** Steady-state plate rise above the heatsink while heating, degrees C */
+    double heat_gain_c;
+
+    /** Steady-state plate drop below the heatsink while cooling, degrees C */
+    double cool_gain_c;
+
+    /** Fraction of the pumped heat that ends up in the heatsink */
+    double sink_coupling;
+
+    /** Electrical power drawn while the Peltier is driven, watts */
+    double power_w;
+
+    /** LM92 (plate) sensor noise, standard deviation in degrees C */
+    double lm92_noise_c;
+
+    /** LM19 (ambient) sensor noise, standard deviation in degrees C */
+    double lm19_noise_c;
+
+    /** MATCH_SET target, degrees C, used to the nearest tenth */
+    double setpoint_c;
+
+    /** Plate offset above ambient at the start of the MATCH scenario, degrees C */
+    double match_offset_c;
+
+    /** Length of each scenario, seconds */
+    double duration_s;
+
+    /** Boxcar window, samples, 1 - WINDOW_MAX */
+    double window_size;
+
+    /** Noise generator seed */
+    double seed;
+
+    /** Controller lookahead, seconds */
+    double lookahead_s;
+
+    /** Average power budget for energy_schedule(), watts; 0 for no limit */
+    double budget_w;
+};
+
+/**
+ * Results of one closed-loop run.
+ */
+struct sim_result
+{
+    double target_c;
+    double final_c;
+    double rise_time_s;
+    double overshoot_c;
+    double steady_error_c;
+    int switches;
+    double energy_j;
+
+    /** Energy drawn until rise_time_s, -1 if never reached */
+    double reach_j;
+
+    /** Mean electrical power over the last quarter of the run, watts */
+    double hold_w;
+};
+
+static struct sim_params params = {
+    .ambient_c = 22.0,
+    .tau_plate_s = 45.0,
+    .tau_sink_s = 240.0,
+    .dead_time_s = 1.5,
+    .heat_gain_c = 30.0,
+    .cool_gain_c = 18.0,
+    .sink_coupling = 0.25,
+    .power_w = 36.0,
+    .lm92_noise_c = 0.05,
+    .lm19_noise_c = 0.4,
+    .setpoint_c = 30.0,
+    .match_offset_c = 6.0,
+    .duration_s = PELTIER_TIMEOUT_S - 5,
+    .window_size = 3,
+    .seed = 465,
+    .lookahead_s = PELTIER_LOOKAHEAD_S,
+    .budget_w = CONTROL_AVERAGE_W,
+};
+
+static unsigned long rng_state;
+
+/**
+ * Standard normal sample from a xorshift generator, so runs are repeatable for a given seed.
+ */
+static double gaussian(void)
+{
+    double u1, u2;
+
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    rng_state &= 0xFFFFFFFFUL;
+    u1 = (rng_state + 1.0) / 4294967297.0;
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    rng_state &= 0xFFFFFFFFUL;
+    u2 = (rng_state + 1.0) / 4294967297.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * Controller state the interrupts in main.c share.
+ */
+static struct energy_budget budget;
+static struct zone zones[CONTROL_ZONE_COUNT];
+static struct keypad_fsm keypad;
+static struct leds leds;
+static struct control control;
+static unsigned int aclk; // TB1R
+
+/**
+ * Frames go nowhere: the simulation only looks at the outputs.
+ */
+static void send_frame(unsigned char index)
+{
+    (void)index;
+}
+
+static unsigned int read_clock(void)
+{
+    return aclk;
+}
+
+/**
+ * LM19 output for a temperature, from the datasheet's quadratic transfer function, as the ADC converts it with the
+ * 1 V full-scale reference lm19_tenths() is written for. Outputs past full scale read LM19_ADC_MAX.
+ */
+static int lm19_counts(double celsius)
+{
+    double volts = 1.8639 - 1.15e-2 * celsius - 3.88e-6 * celsius * celsius;
+    double counts = floor(volts * LM19_ADC_MAX + 0.5);
+
+    return (counts < 0.0) ? 0 : (counts > LM19_ADC_MAX) ? LM19_ADC_MAX : (int)counts;
+}
+
+/**
+ * Power-on state of main.c, unlocked and switched to a mode with the run's setpoint, window and budget.
+ */
+static void reset(enum State state)
+{
+    memset(zones, 0, sizeof(zones));
+    control_configure(zones, &budget);
+    energy_set_average(&budget, (int)params.budget_w);
+    keypad_init(&keypad);
+    keypad.state = UNLOCKED;
+    keypad_select(&keypad, state);
+    keypad_set_setpoint(&keypad, (int)(params.setpoint_c * 10.0 + 0.5));
+    keypad_set_window(&keypad, (int)params.window_size);
+    keypad.events = 0;
+    leds_init(&leds);
+    control_init(&control, zones, CONTROL_ZONE_COUNT, &keypad, &leds, send_frame, read_clock, NULL);
+    peltier_lookahead_s = (int)params.lookahead_s;
+    P1OUT = 0;
+    aclk = 0;
+}
+
+static struct sim_result run_scenario(enum State state, double plate_start_c, double target_c)
+{
+    static enum peltier_drive delay_line[MAX_DEAD_STEPS];
+    struct sim_result result = {0};
+    struct zone *zone = &zones[CONTROL_ZONE_UI];
+    enum peltier_drive drive;
+    int dead_steps = (int)(params.dead_time_s / SIM_DT_S);
+    int steps = (int)(params.duration_s / SIM_DT_S);
+    int sample_steps = (int)(SAMPLE_PERIOD_S / SIM_DT_S);
+    int heartbeat_steps = (int)(HEARTBEAT_PERIOD_S / SIM_DT_S);
+    int rising;
+    double plate = plate_start_c;
+    double sink = params.ambient_c;
+    double steady_sum = 0.0;
+    double hold_j = 0.0;
+    int steady_count = 0;
+    int step;
+
+    if (dead_steps >= MAX_DEAD_STEPS)
+    {
+        dead_steps = MAX_DEAD_STEPS - 1;
+    }
+    memset(delay_line, 0, sizeof(delay_line));
+    reset(state);
+    rng_state = (unsigned long)params.seed;
+    result.rise_time_s = -1.0;
+    result.reach_j = -1.0;
+
+    // HEAT and COOL are open loop, so their target is wherever the plate ends up. Run once to find it.
+    if (isnan(target_c))
+    {
+        double p = plate_start_c;
+        double s = params.ambient_c;
+        double gain = (state == HEAT) ? params.heat_gain_c : -params.cool_gain_c;
+        for (step = 0; step < steps; step++)
+        {
+            double q = (step >= dead_steps) ? gain : 0.0;
+            p += ((s - p) + q) / params.tau_plate_s * SIM_DT_S;
+            s += ((params.ambient_c - s) - params.sink_coupling * q) / params.tau_sink_s * SIM_DT_S;
+        }
+        target_c = p;
+    }
+    result.target_c = target_c;
+    rising = target_c >= plate_start_c;
+
+    for (step = 0; step < steps; step++)
+    {
+        enum peltier_drive applied;
+        double q;
+        double t = step * SIM_DT_S;
+
+        aclk = (unsigned int)(unsigned long)(t * ACLK_HZ);
+        drive = zone->drive;
+
+        if (step % heartbeat_steps == 0 && step != 0)
+        {
+            control_second(&control);
+        }
+
+        // Both reads start in the tick and the pair is controlled on as soon as it is complete
+        if (step % sample_steps == 0)
+        {
+            int lm92_sixteenths = (int)floor((plate + params.lm92_noise_c * gaussian()) * 16.0);
+            int lm19 = lm19_counts(params.ambient_c + params.lm19_noise_c * gaussian());
+            unsigned int epoch = zone_begin(zone, aclk);
+
+            zone_sample(zone, epoch, ZONE_PLATE, lm92_sixteenths, aclk);
+            if (zone_sample(zone, epoch, ZONE_AMBIENT, lm19, aclk))
+            {
+                control_pair_done(&control, CONTROL_ZONE_UI);
+            }
+        }
+        if (zone->drive != drive)
+        {
+            result.switches++;
+        }
+        drive = zone->drive;
+
+        delay_line[step % (dead_steps + 1)] = drive;
+        applied = delay_line[(step + 1) % (dead_steps + 1)];
+        if (step < dead_steps)
+        {
+            applied = PELTIER_OFF;
+        }
+        q = 0.0;
+        if (applied == PELTIER_HEAT)
+        {
+            q = params.heat_gain_c;
+        }
+        else if (applied == PELTIER_COOL)
+        {
+            q = -params.cool_gain_c;
+        }
+        if (drive != PELTIER_OFF)
+        {
+            result.energy_j += params.power_w * SIM_DT_S;
+        }
+
+        plate += ((sink - plate) + q) / params.tau_plate_s * SIM_DT_S;
+        sink += ((params.ambient_c - sink) - params.sink_coupling * q) / params.tau_sink_s * SIM_DT_S;
+
+        if (result.rise_time_s < 0.0 && fabs(target_c - plate_start_c) > 0.5)
+        {
+            double progress = (plate - plate_start_c) / (target_c - plate_start_c);
+            if (progress >= 0.9)
+            {
+                result.rise_time_s = t;
+                result.reach_j = result.energy_j;
+            }
+        }
+        if (rising && plate - target_c > result.overshoot_c)
+        {
+            result.overshoot_c = plate - target_c;
+        }
+        if (!rising && target_c - plate > result.overshoot_c)
+        {
+            result.overshoot_c = target_c - plate;
+        }
+        if (step >= steps * 3 / 4)
+        {
+            steady_sum += fabs(plate - target_c);
+            steady_count++;
+            hold_j += (drive != PELTIER_OFF) ? params.power_w * SIM_DT_S : 0.0;
+        }
+    }
+
+    result.final_c = plate;
+    result.steady_error_c = steady_count ? steady_sum / steady_count : 0.0;
+    result.hold_w = steady_count ? hold_j / (steady_count * SIM_DT_S) : 0.0;
+    return result;
+}
+
+/**
+ * Apply a name=value override to the parameter set.
+ *
+ * @return: 0 on success, -1 if the name is not a parameter.
+ */
+static int set_param(const char *arg)
+{
+    static const struct
+    {
+        const char *name;
+        double *value;
+    } table[] = {
+        {"ambient", &params.ambient_c},       {"tau_plate", &params.tau_plate_s},
+        {"tau_sink", &params.tau_sink_s},     {"dead_time", &params.dead_time_s},
+        {"heat_gain", &params.heat_gain_c},   {"cool_gain", &params.cool_gain_c},
+        {"sink_coupling", &params.sink_coupling}, {"power", &params.power_w},
+        {"lm92_noise", &params.lm92_noise_c}, {"lm19_noise", &params.lm19_noise_c},
+        {"setpoint", &params.setpoint_c},     {"match_offset", &params.match_offset_c},
+        {"duration", &params.duration_s},     {"window", &params.window_size},
+        {"seed", &params.seed},               {"lookahead", &params.lookahead_s},
+        {"budget", &params.budget_w},
+    };
+    const char *equals = strchr(arg, '=');
+    size_t i;
+
+    if (equals == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if (strlen(table[i].name) == (size_t)(equals - arg) && strncmp(arg, table[i].name, equals - arg) == 0)
+        {
+            *table[i].value = atof(equals + 1);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct
+    {
+        const char *name;
+        enum State state;
+    } scenarios[] = {{"HEAT", HEAT}, {"COOL", COOL}, {"MATCH", MATCH}, {"MATCH_SET", MATCH_SET}};
+    static const double budgets[] = {0, 30, 24, 18, 12};
+    double budget_w;
+    clock_t start;
+    double wall_s;
+    size_t i;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (set_param(argv[arg]) != 0)
+        {
+            fprintf(stderr, "unknown parameter: %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    if (params.budget_w < 0 || params.budget_w > ENERGY_AVERAGE_MAX_W)
+    {
+        fprintf(stderr, "budget outside 0 - %d W\n", ENERGY_AVERAGE_MAX_W);
+        return 1;
+    }
+    if (params.window_size < 1 || params.window_size > WINDOW_MAX)
+    {
+        fprintf(stderr, "window outside 1 - %d\n", WINDOW_MAX);
+        return 1;
+    }
+    if (params.setpoint_c < 0 || params.setpoint_c > SETPOINT_MAX_TENTHS / 10.0)
+    {
+        fprintf(stderr, "setpoint outside 0 - %d.%d C\n", SETPOINT_MAX_TENTHS / 10, SETPOINT_MAX_TENTHS % 10);
+        return 1;
+    }
+
+    printf("%-10s %8s %8s %9s %10s %9s %8s %10s\n", "scenario", "target", "final", "rise_s", "overshoot", "ss_err",
+           "switches", "energy_J");
+
+    start = clock();
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        struct sim_result r;
+
+        switch (scenarios[i].state)
+        {
+            case MATCH:
+                r = run_scenario(MATCH, params.ambient_c + params.match_offset_c, params.ambient_c);
+                break;
+
+            case MATCH_SET:
+                r = run_scenario(MATCH_SET, params.ambient_c, params.setpoint_c);
+                break;
+
+            default:
+                r = run_scenario(scenarios[i].state, params.ambient_c, NAN);
+                break;
+        }
+
+        printf("%-10s %8.2f %8.2f %9.1f %10.2f %9.2f %8d %10.0f\n", scenarios[i].name, r.target_c, r.final_c,
+               r.rise_time_s, r.overshoot_c, r.steady_error_c, r.switches, r.energy_j);
+    }
+
+    // MATCH_SET under each budget, no limit first
+    printf("\n%-10s %9s %10s %9s %8s %9s %8s %10s\n", "budget_W", "rise_s", "overshoot", "ss_err", "switches",
+           "reach_J", "hold_W", "energy_J");
+    budget_w = params.budget_w;
+    for (i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++)
+    {
+        struct sim_result r;
+
+        params.budget_w = budgets[i];
+        r = run_scenario(MATCH_SET, params.ambient_c, params.setpoint_c);
+        if (budgets[i] == 0)
+        {
+            printf("%-10s", "unlimited");
+        }
+        else
+        {
+            printf("%-10.0f", budgets[i]);
+        }
+        printf(" %9.1f %10.2f %9.2f %8d %9.0f %8.1f %10.0f\n", r.rise_time_s, r.overshoot_c, r.steady_error_c,
+               r.switches, r.reach_j, r.hold_w, r.energy_j);
+    }
+    params.budget_w = budget_w;
+    wall_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("simulated %.0f s in %.3f s wall\n",
+           params.duration_s * (sizeof(scenarios) / sizeof(scenarios[0]) + sizeof(budgets) / sizeof(budgets[0])),
+           wall_s);
+    return 0;
+}
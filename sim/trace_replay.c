@@ -0,0 +1,582 @@
+/**
+ * @file
+ * @brief Deterministic replay of recorded controller input traces.
+ *
+ * A trace (controller/app/trace.h) holds every input the firmware took, in the order its interrupts took them. The
+ * replay feeds each event to the same controller glue (controller/app/control.h) the interrupt hands it to, and
+ * collects the outputs: every LCD frame as it would be loaded into tx_buffer, every control decision with the heat/cool
+ * pins it leaves set, and every UART reply line. Timing does not matter to any of these, only order, so the replay
+ * runs as fast as the host allows.
+ *
+ * The outputs are printed one per line. Given a golden output file, they are compared with it byte for byte instead
+ * and the first difference is reported. Replay throughput is reported in events per second, along with the largest
+ * span from a tick to its zone's second reading. That comes from the recorded time stamps alone, so for a scripted
+ * session it is whatever the script stamped; only the board measures the real sample-to-output latency.
+ *
+ * Traces come from a TRACE build of the firmware, dumped from the debugger, or from the "record" mode here, which runs
+ * a scripted bench session (unlock, heat, queries over the UART, match and setpoint modes, a stuck sensor read, a
+ * remote lock) in closed loop against a crude plate model and records its inputs through trace_record(), as the
+ * firmware would.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "control.h"
+#include "keypad.h"
+#include "lcd_frame.h"
+#include "lm92.h"
+#include "peltier.h"
+#include "supervisor.h"
+#include "trace.h"
+#include "uart_cmd.h"
+#include "zone.h"
+
+#define OUTPUT_MAX 65536         // Output of one replay, bytes
+#define BENCH_SECONDS 1.0        // Replay repeatedly for at least this long to time it
+#define SECOND_COUNTS 32768
+#define RECORD_SECONDS 136       // Length of the recorded session
+#define AMBIENT_COUNTS 4000      // LM19 reading of the recorded session's ambient
+#define STUCK_SECOND 100         // The recorded session's LM92 read hangs in the first tick of this second
+#define SUPERVISOR_PERIOD 4096   // As in main.c
+#define UART_CHAR_COUNTS 34      // One character at 9600 baud
+
+volatile unsigned char P1OUT;
+volatile unsigned char P5OUT;
+volatile unsigned char P6OUT;
+
+/**
+ * Controller state the interrupts in main.c share.
+ */
+static struct energy_budget budget;
+static struct zone zones[ZONE_MAX]; // Room for a trace from a build with more zones
+static struct keypad_fsm keypad;
+static struct leds leds;
+static struct uart_cmd uart;
+static struct control control;
+static unsigned int epochs[ZONE_MAX]; // adc_epoch and lm92_epoch, which are always the same
+static unsigned int event_time;       // Time stamp of the input being replayed
+static int uart_pulled;               // First byte of a reply line the TX interrupt has taken but not printed, or -1
+
+/**
+ * Outputs of the replay so far.
+ */
+static char output[OUTPUT_MAX];
+static size_t output_length;
+
+static void emit(const char *format, ...)
+{
+    va_list args;
+    int written;
+
+    va_start(args, format);
+    written = vsnprintf(output + output_length, sizeof(output) - output_length, format, args);
+    va_end(args);
+    if (written > 0)
+    {
+        output_length += (size_t)written;
+        if (output_length >= sizeof(output))
+        {
+            output_length = sizeof(output) - 1;
+        }
+    }
+}
+
+/**
+ * send_I2C_data(): the frame as loaded into tx_buffer.
+ */
+static void send_frame(unsigned char index)
+{
+    char frame[LCD_FRAME_BYTES];
+    int i;
+
+    control_frame(&control, index, frame);
+    emit("F");
+    for (i = 0; i < LCD_FRAME_BYTES; i++)
+    {
+        emit(" %02x", (unsigned char)frame[i]);
+    }
+    emit("\n");
+}
+
+/**
+ * A zone's outputs were set: the drive and the heat/cool pins it leaves set.
+ */
+static void actuated(unsigned char index)
+{
+    const struct zone *zone = &zones[index];
+
+    emit("A %u %d %02x\n", index, zone->drive, *zone->port & (zone->heat_pin | zone->cool_pin));
+}
+
+/**
+ * TB1R while an input is taken: its recorded arrival time, as processing takes no time in the replay.
+ */
+static unsigned int read_clock(void)
+{
+    return event_time;
+}
+
+/**
+ * Power-on state of main.c.
+ */
+static void reset(void)
+{
+    memset(zones, 0, sizeof(zones));
+    memset(epochs, 0, sizeof(epochs));
+    control_configure(zones, &budget);
+    keypad_init(&keypad);
+    leds_init(&leds);
+    control_init(&control, zones, CONTROL_ZONE_COUNT, &keypad, &leds, send_frame, read_clock, actuated);
+    uart_cmd_init(&uart, &keypad, zones, CONTROL_ZONE_COUNT);
+    peltier_lookahead_s = PELTIER_LOOKAHEAD_S;
+    P1OUT = 0;
+    uart_pulled = -1;
+    output_length = 0;
+}
+
+/**
+ * ADC_ISR and USCI_B1_ISR after a reading.
+ */
+static void reading(unsigned char arg, int raw, unsigned int time)
+{
+    unsigned char index = arg >> 1;
+    unsigned char role = arg & 1;
+
+    if (index < CONTROL_ZONE_COUNT && zone_sample(&zones[index], epochs[index], role, raw, time))
+    {
+        control_pair_done(&control, index);
+    }
+}
+
+/**
+ * USCI_A1_ISR, RX. A command that runs starts its reply; the reply goes out as its TRACE_UART_SENT events come in.
+ */
+static void uart_byte(char c)
+{
+    if (uart_cmd_receive(&uart, c))
+    {
+        control_events(&control);
+    }
+}
+
+/**
+ * Characters of the reply line going out that are still to print, 0 if none is.
+ */
+static int uart_line_chars(void)
+{
+    return (uart.reply_length - uart.reply_index) + (uart_pulled >= 0);
+}
+
+/**
+ * Print a reply byte. CR is left out, so each reply line ends up on an output line of its own.
+ */
+static void emit_reply(int byte)
+{
+    if (byte != '\r')
+    {
+        emit("%c", byte);
+    }
+}
+
+/**
+ * USCI_A1_ISR, TX with the last reply line out. The bytes before its end changed nothing, so the line is printed in
+ * one go; then, as on the board, the next line of a stream is formatted, or a line held meanwhile runs.
+ */
+static void uart_sent(void)
+{
+    int byte;
+
+    if (uart_line_chars() > 0)
+    {
+        emit("U ");
+        if (uart_pulled >= 0)
+        {
+            emit_reply(uart_pulled);
+            uart_pulled = -1;
+        }
+        while (uart.reply_index < uart.reply_length)
+        {
+            emit_reply(uart_cmd_transmit(&uart));
+        }
+    }
+    byte = uart_cmd_transmit(&uart);
+    if (byte < 0 && uart_cmd_poll(&uart))
+    {
+        control_events(&control); // A command that arrived during the last reply
+        byte = uart_cmd_transmit(&uart);
+    }
+    uart_pulled = byte;
+}
+
+/**
+ * Take one recorded input as its interrupt would.
+ */
+static void replay_event(const struct trace_event *event)
+{
+    unsigned char data[2];
+
+    event_time = event->time;
+    switch (event->type)
+    {
+    case TRACE_ADC:
+        reading(event->arg, event->value, event->time);
+        break;
+    case TRACE_LM92:
+        data[0] = event->value >> 8;
+        data[1] = event->value & 0xFF;
+        if ((event->arg >> 1) < CONTROL_ZONE_COUNT)
+        {
+            zones[event->arg >> 1].alarms[event->arg & 1] = lm92_status(data);
+        }
+        reading(event->arg, lm92_sixteenths(data), event->time);
+        break;
+    case TRACE_KEY:
+        keypad_dispatch(&keypad, event->arg);
+        control_events(&control);
+        break;
+    case TRACE_TICK:
+        if (keypad.state != LOCKED && event->arg < CONTROL_ZONE_COUNT)
+        {
+            epochs[event->arg] = zone_begin(&zones[event->arg], event->time);
+        }
+        break;
+    case TRACE_SECOND:
+        control_second(&control);
+        break;
+    case TRACE_UART:
+        uart_byte((char)event->arg);
+        break;
+    case TRACE_UART_SENT:
+        uart_sent();
+        break;
+    case TRACE_LOCKOUT:
+        keypad_lock(&keypad);
+        send_frame(CONTROL_ZONE_UI);
+        break;
+    case TRACE_SUPERVISOR:
+        emit("S %02x %u\n", event->arg, event->value); // Deadlines missed, watchdog fed
+        control_recover(&control, event->arg);
+        break;
+    default:
+        break;
+    }
+}
+
+static void replay(const struct trace_log *log)
+{
+    unsigned int i;
+
+    reset();
+    for (i = 0; i < log->count; i++)
+    {
+        replay_event(&log->events[i]);
+    }
+}
+
+/**
+ * Load a trace file.
+ *
+ * @return: 0 on success, -1 if the file cannot be read or is not a trace.
+ */
+static int load(const char *path, struct trace_log *log)
+{
+    unsigned char bytes[TRACE_EVENT_BYTES];
+    FILE *file = fopen(path, "rb");
+    unsigned int i;
+
+    if (file == NULL || fread(bytes, 1, TRACE_HEADER_BYTES, file) != TRACE_HEADER_BYTES)
+    {
+        return -1;
+    }
+    log->magic = bytes[0] | (bytes[1] << 8);
+    log->count = bytes[2] | (bytes[3] << 8);
+    if (log->magic != TRACE_MAGIC || log->count > TRACE_EVENTS)
+    {
+        fclose(file);
+        return -1;
+    }
+    for (i = 0; i < log->count; i++)
+    {
+        if (fread(bytes, 1, TRACE_EVENT_BYTES, file) != TRACE_EVENT_BYTES)
+        {
+            fclose(file);
+            return -1;
+        }
+        trace_event_read(bytes, &log->events[i]);
+    }
+    fclose(file);
+    return 0;
+}
+
+static int save(const char *path, const struct trace_log *log)
+{
+    unsigned char bytes[TRACE_EVENT_BYTES];
+    FILE *file = fopen(path, "wb");
+    unsigned int i;
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+    bytes[0] = log->magic & 0xFF;
+    bytes[1] = log->magic >> 8;
+    bytes[2] = log->count & 0xFF;
+    bytes[3] = log->count >> 8;
+    fwrite(bytes, 1, TRACE_HEADER_BYTES, file);
+    for (i = 0; i < log->count; i++)
+    {
+        trace_event_write(&log->events[i], bytes);
+        fwrite(bytes, 1, TRACE_EVENT_BYTES, file);
+    }
+    return fclose(file);
+}
+
+/**
+ * Record an input and take it at once, as the firmware's interrupt would. Once the log is full the session goes on
+ * without its inputs, as it would on the board.
+ */
+static void record(struct trace_log *log, unsigned long now, uint8_t type, uint8_t arg, uint16_t value)
+{
+    uint16_t count = log->count;
+
+    trace_record(log, (uint16_t)now, type, arg, value);
+    if (log->count != count)
+    {
+        replay_event(&log->events[count]);
+    }
+}
+
+/**
+ * Scripted session inputs, each at a time in seconds.
+ */
+struct session_input
+{
+    unsigned int second;
+    const char *keys;
+    const char *uart;
+};
+
+static const struct session_input session[] = {
+    {2, "2659", NULL},
+    {4, "A", NULL},
+    {20, NULL, "Q\r"},
+    {30, NULL, "W 4\r"},
+    {40, NULL, "M MATCH\r"},
+    {60, NULL, "T 650\r"},
+    {61, NULL, "M SET\r"},
+    {90, "0", NULL},
+    {91, "8#", NULL},
+    {110, NULL, "G 5\rQ\r"},
+    {115, NULL, "H\r"},
+    {120, NULL, "E\r"},
+    {125, NULL, "L\r"},
+    {130, "2659D", NULL},
+};
+
+/**
+ * Type a line at the UART one character at a time and record each reply line finishing, until the replies are out.
+ * A line typed while a reply is going out is held, or its characters discarded, exactly as on the board.
+ */
+static void record_uart(struct trace_log *log, unsigned long *now, const char *text)
+{
+    unsigned long line_end = 0;
+    int sending = 0;
+
+    for (;;)
+    {
+        if (!sending && uart_line_chars() > 0)
+        {
+            sending = 1; // A reply line started with the last input
+            line_end = *now + (unsigned long)uart_line_chars() * UART_CHAR_COUNTS;
+        }
+        if (sending && (*text == '\0' || line_end < *now + UART_CHAR_COUNTS))
+        {
+            record(log, *now = line_end, TRACE_UART_SENT, 0, 0);
+            sending = 0;
+        }
+        else if (*text != '\0')
+        {
+            record(log, *now += UART_CHAR_COUNTS, TRACE_UART, *text++, 0);
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Run the scripted session against a plate model and record its inputs.
+ */
+static void record_session(struct trace_log *log)
+{
+    unsigned long now = 0;
+    unsigned long seed = 1;
+    int plate_c16 = 60 * 16; // Plate, 1/16 degree C
+    size_t next = 0;
+    unsigned int second;
+
+    reset();
+    trace_start(log);
+    for (second = 0; second < RECORD_SECONDS; second++)
+    {
+        int tick;
+
+        if (next < sizeof(session) / sizeof(session[0]) && session[next].second == second)
+        {
+            const char *c;
+
+            for (c = session[next].keys; c != NULL && *c != '\0'; c++)
+            {
+                record(log, now += 300, TRACE_KEY, keypad_key(*c), 0);
+            }
+            if (session[next].uart != NULL)
+            {
+                record_uart(log, &now, session[next].uart);
+            }
+            next++;
+        }
+        for (tick = 0; tick < SECOND_COUNTS / CONTROL_PERIOD; tick++)
+        {
+            unsigned long start = (unsigned long)second * SECOND_COUNTS + (unsigned long)tick * CONTROL_PERIOD;
+            int noise;
+
+            now = (now > start) ? now : start;
+            if (keypad.state != LOCKED)
+            {
+                record(log, now, TRACE_TICK, 0, 0);
+            }
+
+            // Plate follows the drive at 0.25 C per tick and leaks a sixteenth towards ambient
+            plate_c16 += (zones[0].drive == PELTIER_HEAT) ? 4 : (zones[0].drive == PELTIER_COOL) ? -4 : 0;
+            plate_c16 += (plate_c16 * 10 < zones[0].tenths[ZONE_AMBIENT] * 16) ? 1 : -1;
+            seed = seed * 1103515245UL + 12345UL;
+            noise = (int)((seed >> 16) % 3) - 1;
+
+            record(log, now + 3, TRACE_ADC, CONTROL_ZONE_UI << 1 | ZONE_AMBIENT, AMBIENT_COUNTS + noise);
+            if (second == STUCK_SECOND && tick == 0)
+            {
+                // No LM92 reading; the acquisition deadline, two supervisor ticks, runs out and recovery stops the zone
+                record(log, now += 2 * SUPERVISOR_PERIOD, TRACE_SUPERVISOR, 1 << SUPERVISOR_ACQUISITION, 1);
+                continue;
+            }
+            record(log, now + 12, TRACE_LM92, CONTROL_ZONE_UI << 1 | ZONE_PLATE,
+                   (uint16_t)((plate_c16 + noise) * 8));
+            now += 12;
+        }
+        record(log, now = (unsigned long)(second + 1) * SECOND_COUNTS, TRACE_SECOND, 0, 0);
+    }
+}
+
+/**
+ * Compare the replay output with a golden output file, line by line.
+ *
+ * @return: Number of differing lines, or -1 if the file cannot be read.
+ */
+static int compare(const char *path)
+{
+    static char golden[OUTPUT_MAX];
+    FILE *file = fopen(path, "rb");
+    size_t golden_length;
+    size_t expected = 0;
+    size_t actual = 0;
+    int line = 1;
+    int differences = 0;
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+    golden_length = fread(golden, 1, sizeof(golden), file);
+    fclose(file);
+
+    while (expected < golden_length || actual < output_length)
+    {
+        size_t expected_end = expected;
+        size_t actual_end = actual;
+
+        while (expected_end < golden_length && golden[expected_end] != '\n')
+        {
+            expected_end++;
+        }
+        while (actual_end < output_length && output[actual_end] != '\n')
+        {
+            actual_end++;
+        }
+        if (expected_end - expected != actual_end - actual ||
+            memcmp(golden + expected, output + actual, actual_end - actual) != 0)
+        {
+            if (differences == 0)
+            {
+                printf("first difference, line %d\n  golden: %.*s\n  replay: %.*s\n", line,
+                       (int)(expected_end - expected), golden + expected, (int)(actual_end - actual), output + actual);
+            }
+            differences++;
+        }
+        expected = expected_end + 1;
+        actual = actual_end + 1;
+        line++;
+    }
+    return differences;
+}
+
+static double now_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct trace_log log;
+    double start;
+    double elapsed;
+    long replays = 0;
+    int differences;
+
+    if (argc == 3 && strcmp(argv[1], "record") == 0)
+    {
+        record_session(&log);
+        if (save(argv[2], &log) != 0)
+        {
+            fprintf(stderr, "cannot write %s\n", argv[2]);
+            return 1;
+        }
+        fprintf(stderr, "%u events recorded\n", log.count);
+        return 0;
+    }
+    if (argc < 2 || load(argv[1], &log) != 0)
+    {
+        fprintf(stderr, "usage: %s trace [golden]\n       %s record trace\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    start = now_s();
+    do
+    {
+        replay(&log);
+        replays++;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_SECONDS);
+    fprintf(stderr, "%u events, %ld replays, %.0f events/s, recorded tick-to-reading span max %.0f us\n", log.count,
+            replays, log.count * replays / elapsed, zones[CONTROL_ZONE_UI].latency_max * 1e6 / SECOND_COUNTS);
+
+    if (argc < 3)
+    {
+        fwrite(output, 1, output_length, stdout);
+        return 0;
+    }
+    differences = compare(argv[2]);
+    if (differences < 0)
+    {
+        fprintf(stderr, "cannot read %s\n", argv[2]);
+        return 1;
+    }
+    printf("%s: %d differing lines\n", argv[2], differences);
+    return differences ? 1 : 0;
+}
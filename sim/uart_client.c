@@ -0,0 +1,331 @@
+/**
+ * @file
+ * @brief Scripted test client for the UART command interface.
+ *
+ * Runs a fixed command script and checks every reply. With a serial device argument it talks to the controller over
+ * that port at 9600 8N1. Without one it opens a pseudo-terminal and forks a child that plays the controller, feeding
+ * the bytes it receives through the firmware's own uart_cmd parser one at a time, as the RX interrupt does, and
+ * writing the reply bytes back as the TX interrupt would.
+ *
+ * The round trip of each command, from the first byte written to the last reply byte read, is reported. Over the
+ * pseudo-terminal that is the parser plus the host's scheduling; against the board it is dominated by the 1.04 ms per
+ * byte of 9600 baud.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uart_cmd.h"
+
+#define REPLY_TIMEOUT_MS 2000
+#define LINE_MAX 256
+
+volatile unsigned char P1OUT;
+volatile unsigned char P5OUT;
+volatile unsigned char P6OUT;
+
+/**
+ * One scripted command and a string its final reply line must contain.
+ */
+struct step
+{
+    const char *command;
+    const char *expect;
+};
+
+static const struct step script[] = {
+    {"U 2659", "OK"},
+    {"L", "OK"},
+    {"M HEAT", "ERR LOCKED"},
+    {"Q", "OK mode=LOCKED"},
+    {"U 1234", "ERR CODE"},
+    {"U 26a9", "ERR SYNTAX"},
+    {"U 11112659", "ERR SYNTAX"},
+    {"U 265", "ERR SYNTAX"},
+    {"Q", "mode=LOCKED"},
+    {"U 2659", "OK"},
+    {"M HEAT", "OK"},
+    {"Q", "OK mode=HEAT"},
+    {"T 255", "OK"},
+    {"T 1000", "ERR RANGE"},
+    {"T -1", "ERR RANGE"},
+    {"T", "ERR SYNTAX"},
+    {"M SET", "OK"},
+    {"Q", "setpoint=255"},
+    {"W 5", "OK"},
+    {"W 0", "ERR RANGE"},
+    {"W five", "ERR SYNTAX"},
+    {"W", "ERR SYNTAX"},
+    {"G 4", "OK"},
+    {"G 31", "ERR RANGE"},
+    {"Q", "gain=4"},
+    {"Q", "alarm=0"},
+    {"Q 9", "ERR ZONE"},
+    {"P 30", "OK"},
+    {"P 256", "ERR RANGE"},
+    {"E", "avg=30 peak=3000"},
+    {"E 9", "ERR ZONE"},
+    {"X", "ERR SYNTAX"},
+    {"M WARM", "ERR SYNTAX"},
+    {"T 0000000000000000000000000255", "ERR LONG"},
+    {"H", "OK"},
+    {"M OFF", "OK"},
+    {"G 2", "OK"},
+};
+
+static double now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static int set_raw(int fd, speed_t speed)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/**
+ * Read one line, CR LF stripped.
+ *
+ * @return: 0 on success, -1 on timeout or error.
+ */
+static int read_line(int fd, char *line, size_t size)
+{
+    struct pollfd ready = {.fd = fd, .events = POLLIN};
+    size_t length = 0;
+    char c;
+
+    for (;;)
+    {
+        if (poll(&ready, 1, REPLY_TIMEOUT_MS) <= 0 || read(fd, &c, 1) != 1)
+        {
+            return -1;
+        }
+        if (c == '\n')
+        {
+            break;
+        }
+        if (c != '\r' && length < size - 1)
+        {
+            line[length++] = c;
+        }
+    }
+    line[length] = '\0';
+    return 0;
+}
+
+/**
+ * Read reply lines until the final OK or ERR line, printing any streamed lines before it.
+ *
+ * @return: Number of streamed lines, or -1 on timeout.
+ */
+static int read_reply(int fd, char *line, size_t size)
+{
+    int streamed = 0;
+
+    for (;;)
+    {
+        if (read_line(fd, line, size) != 0)
+        {
+            return -1;
+        }
+        if (strncmp(line, "OK", 2) == 0 || strncmp(line, "ERR", 3) == 0)
+        {
+            return streamed;
+        }
+        printf("    %s\n", line);
+        streamed++;
+    }
+}
+
+/**
+ * Play the controller on the slave side of the pseudo-terminal until the client hangs up.
+ */
+static void emulate(int fd)
+{
+    static struct energy_budget budget;
+    static struct zone zones[1] = {
+        {.sources = {{SOURCE_LM92, 0x48}, {SOURCE_ADC, 1}}, .mode = OFF, .port = &P1OUT, .heat_pin = 0x80,
+         .cool_pin = 0x40, .budget = &budget},
+    };
+    struct keypad_fsm keypad;
+    struct uart_cmd uart;
+    char in[64];
+    char out[UART_CMD_REPLY_MAX * 4];
+    ssize_t received;
+    int sending = 0;
+    int i;
+
+    energy_init(&budget, Q16_16(ENERGY_RATED_W * 0.5), 1, 24, 3000);
+    keypad_init(&keypad);
+    uart_cmd_init(&uart, &keypad, zones, 1);
+    for (i = 0; i < STATS_WINDOW + 4; i++)
+    {
+        zones[0].tenths[ZONE_PLATE] = 300 - 3 * i;
+        zones[0].tenths[ZONE_AMBIENT] = 220 + (i & 1);
+        stats_push(&zones[0].stats[ZONE_PLATE], zones[0].tenths[ZONE_PLATE]);
+        stats_push(&zones[0].stats[ZONE_AMBIENT], zones[0].tenths[ZONE_AMBIENT]);
+    }
+
+    while ((received = read(fd, in, sizeof(in))) > 0)
+    {
+        // Everything that arrived is taken before any reply goes out, so a second line can land mid-reply
+        for (i = 0; i < received; i++)
+        {
+            sending |= uart_cmd_receive(&uart, in[i]);
+        }
+        while (sending)
+        {
+            size_t length = 0;
+            int byte;
+
+            while ((byte = uart_cmd_transmit(&uart)) >= 0)
+            {
+                if (length == sizeof(out))
+                {
+                    if (write(fd, out, length) != (ssize_t)length)
+                    {
+                        return;
+                    }
+                    length = 0;
+                }
+                out[length++] = (char)byte;
+            }
+            if (write(fd, out, length) != (ssize_t)length)
+            {
+                return;
+            }
+            sending = uart_cmd_poll(&uart);
+        }
+    }
+}
+
+/**
+ * Open a pseudo-terminal and start the emulated controller on it.
+ *
+ * @return: Client side file descriptor, -1 on failure.
+ */
+static int start_emulator(pid_t *child)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    int slave;
+
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        return -1;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0 || set_raw(slave, B9600) != 0)
+    {
+        return -1;
+    }
+
+    *child = fork();
+    if (*child == 0)
+    {
+        close(master);
+        emulate(slave);
+        _exit(0);
+    }
+    close(slave);
+    return master;
+}
+
+int main(int argc, char *argv[])
+{
+    char line[LINE_MAX];
+    double total_us = 0;
+    double worst_us = 0;
+    pid_t child = -1;
+    int failures = 0;
+    size_t i;
+    int fd;
+
+    if (argc >= 2)
+    {
+        fd = open(argv[1], O_RDWR | O_NOCTTY);
+        if (fd < 0 || set_raw(fd, B9600) != 0)
+        {
+            fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        fd = start_emulator(&child);
+        if (fd < 0)
+        {
+            fprintf(stderr, "cannot open a pseudo-terminal\n");
+            return 1;
+        }
+    }
+
+    for (i = 0; i < sizeof(script) / sizeof(script[0]); i++)
+    {
+        double start = now_us();
+        double elapsed;
+        int streamed;
+
+        if (write(fd, script[i].command, strlen(script[i].command)) < 0 || write(fd, "\r", 1) != 1)
+        {
+            fprintf(stderr, "write failed\n");
+            return 1;
+        }
+        streamed = read_reply(fd, line, sizeof(line));
+        elapsed = now_us() - start;
+        total_us += elapsed;
+        worst_us = (elapsed > worst_us) ? elapsed : worst_us;
+
+        if (streamed < 0)
+        {
+            printf("FAIL %-34s timeout\n", script[i].command);
+            failures++;
+            continue;
+        }
+        if (strstr(line, script[i].expect) == NULL)
+        {
+            printf("FAIL %-34s %s (expected %s)\n", script[i].command, line, script[i].expect);
+            failures++;
+            continue;
+        }
+        printf("ok   %-34s %8.0f us  %s\n", script[i].command, elapsed, line);
+    }
+
+    // Two commands back to back: the second arrives while the first reply is still going out
+    if (write(fd, "Q\rQ 0\r", 6) != 6 || read_reply(fd, line, sizeof(line)) < 0 ||
+        strncmp(line, "OK", 2) != 0 || read_reply(fd, line, sizeof(line)) < 0 || strncmp(line, "OK", 2) != 0)
+    {
+        printf("FAIL pipelined commands\n");
+        failures++;
+    }
+    else
+    {
+        printf("ok   pipelined commands\n");
+    }
+
+    printf("%zu commands, mean round trip %.0f us, worst %.0f us, %d failures\n", i, total_us / i, worst_us, failures);
+
+    close(fd);
+    if (child > 0)
+    {
+        waitpid(child, NULL, 0);
+    }
+    return failures ? 1 : 0;
+}
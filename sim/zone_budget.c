@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Maximum zone count for a control period on the MSP430FR2355.
+ *
+ * Zones are serviced one per scheduler tick, so with N zones each tick is period / N long and has to fit one zone's
+ * sensor reads and its control update. The LM92 and ADC reads overlap, the control update runs on the CPU while
+ * they are in flight, and the next tick cannot start a read until the previous one is off the bus.
+ *
+ * Bus and converter times follow from the firmware configuration (100 kHz UCB1, ADCSHT_2 at 1 MHz). The CPU cost of
+ * one zone update is an argument: take zone_update from kernel_bench built for the target.
+ *
+ * Usage: zone_budget [period_ms] [zone_update_cycles] [mclk_hz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "zone.h"
+
+#define I2C_HZ 100000.0
+#define LM92_READ_BITS 29.0   // Start, address + ACK, two data bytes + ACK/NACK, stop
+#define ADC_CLOCK_HZ 1000000.0
+#define ADC_CONVERSION_CLOCKS 30.0 // 16 sample-and-hold clocks (ADCSHT_2) + 14 conversion clocks
+#define MAX_ZONES_SHOWN 16
+
+int main(int argc, char *argv[])
+{
+    double period_ms = (argc > 1) ? atof(argv[1]) : 500.0;
+    double zone_cycles = (argc > 2) ? atof(argv[2]) : 4000.0;
+    double mclk_hz = (argc > 3) ? atof(argv[3]) : 1000000.0;
+    double lm92_ms = LM92_READ_BITS / I2C_HZ * 1000.0;
+    double adc_ms = ADC_CONVERSION_CLOCKS / ADC_CLOCK_HZ * 1000.0;
+    double cpu_ms = zone_cycles / mclk_hz * 1000.0;
+    double busy_ms = (lm92_ms > adc_ms ? lm92_ms : adc_ms) + cpu_ms;
+    int max_timing = 0;
+    int n;
+
+    printf("period %.1f ms, zone update %.0f cycles at %.0f Hz\n", period_ms, zone_cycles, mclk_hz);
+    printf("per zone: LM92 read %.3f ms, ADC %.3f ms, CPU %.3f ms, busy %.3f ms\n\n", lm92_ms, adc_ms, cpu_ms, busy_ms);
+    printf("%6s %9s %7s %s\n", "zones", "tick_ms", "load", "fits");
+    for (n = 1; n <= MAX_ZONES_SHOWN; n++)
+    {
+        double tick_ms = period_ms / n;
+        int fits = busy_ms <= tick_ms;
+
+        if (fits)
+        {
+            max_timing = n;
+        }
+        printf("%6d %9.3f %6.1f%% %s\n", n, tick_ms, 100.0 * busy_ms / tick_ms, fits ? "yes" : "no");
+    }
+
+    // Past the table, the count is bounded by timing alone until it reaches the LM92 address limit
+    if (max_timing == MAX_ZONES_SHOWN)
+    {
+        max_timing = (int)(period_ms / busy_ms);
+    }
+    printf("\nmax zones by timing: %d\n", max_timing);
+    printf("max zones with one LM92 each (UCB1 addresses 0x48 - 0x4B): %d\n",
+           max_timing < ZONE_MAX ? max_timing : ZONE_MAX);
+    return 0;
+}